@@ -1,9 +1,10 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Minimal configuration for demo inmates, 1 CPU, 1 MB RAM, 1 serial port
+ * Minimal configuration for demo inmates, 1 CPU, 1 MB RAM, 1 serial port,
+ * direct access to the TSC deadline timer and the performance counters
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -23,6 +24,7 @@ struct {
 	struct jailhouse_memory mem_regions[2];
 	struct jailhouse_cache cache_regions[1];
 	__u8 pio_bitmap[0x2000];
+	struct jailhouse_msr_range msr_ranges[5];
 } __attribute__((packed)) config = {
 	.cell = {
 		.signature = JAILHOUSE_CELL_DESC_SIGNATURE,
@@ -34,6 +36,7 @@ struct {
 		.num_irqchips = 0,
 		.pio_bitmap_size = ARRAY_SIZE(config.pio_bitmap),
 		.num_pci_devices = 0,
+		.num_msr_ranges = ARRAY_SIZE(config.msr_ranges),
 	},
 
 	.cpus = {
@@ -71,4 +74,32 @@ struct {
 		[0xe010/8 ... 0xe017/8] = 0, /* OXPCIe952 serial1 */
 		[0xe018/8 ... 0xffff/8] = -1,
 	},
+
+	.msr_ranges = {
+		/* IA32_PMC0..7 */ {
+			.start = 0xc1,
+			.size = 8,
+			.flags = JAILHOUSE_MSR_READ | JAILHOUSE_MSR_WRITE,
+		},
+		/* IA32_PERFEVTSEL0..7 */ {
+			.start = 0x186,
+			.size = 8,
+			.flags = JAILHOUSE_MSR_READ | JAILHOUSE_MSR_WRITE,
+		},
+		/* IA32_FIXED_CTR0..2 */ {
+			.start = 0x309,
+			.size = 3,
+			.flags = JAILHOUSE_MSR_READ | JAILHOUSE_MSR_WRITE,
+		},
+		/* IA32_TSC_DEADLINE */ {
+			.start = 0x6e0,
+			.size = 1,
+			.flags = JAILHOUSE_MSR_READ | JAILHOUSE_MSR_WRITE,
+		},
+		/* IA32_EFER */ {
+			.start = 0xc0000080,
+			.size = 1,
+			.flags = JAILHOUSE_MSR_READ | JAILHOUSE_MSR_WRITE,
+		},
+	},
 };
@@ -3,7 +3,7 @@
  *
  * Test configuration for Banana Pi board (A20 dual-core Cortex-A7, 1G RAM)
  *
- * Copyright (c) Siemens AG, 2014
+ * Copyright (c) Siemens AG, 2014, 2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -34,6 +34,10 @@ struct {
 			.size = 0x1000,
 			.flags = JAILHOUSE_MEM_IO,
 		},
+		.platform_info.arm = {
+			/* 256 KB 8-way L2 */
+			.cache_colors = 8,
+		},
 		.root_cell = {
 			.name = "Banana-Pi",
 
@@ -0,0 +1,70 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Configuration for 64-bit demo inmates, 1 CPU, 1 MB RAM, 1 serial port,
+ * starting directly in 64-bit mode
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <linux/types.h>
+#include <jailhouse/cell-config.h>
+
+#define ARRAY_SIZE(a) sizeof(a) / sizeof(a[0])
+
+struct {
+	struct jailhouse_cell_desc cell;
+	__u64 cpus[1];
+	struct jailhouse_memory mem_regions[2];
+	__u8 pio_bitmap[0x2000];
+} __attribute__((packed)) config = {
+	.cell = {
+		.signature = JAILHOUSE_CELL_DESC_SIGNATURE,
+		.name = "direct-boot-demo",
+		.flags = JAILHOUSE_CELL_PASSIVE_COMMREG |
+			JAILHOUSE_CELL_LONG_MODE_BOOT,
+
+		.cpu_set_size = sizeof(config.cpus),
+		.num_memory_regions = ARRAY_SIZE(config.mem_regions),
+		.num_irqchips = 0,
+		.pio_bitmap_size = ARRAY_SIZE(config.pio_bitmap),
+		.num_pci_devices = 0,
+
+		/* fixed locations of the 64-bit inmate library */
+		.boot_entry = 0x000ff040,
+		.boot_page_table = 0x000fc000,
+		.boot_gdt = 0x000ff000,
+		.boot_gdt_limit = 0x1f,
+	},
+
+	.cpus = {
+		0x4,
+	},
+
+	.mem_regions = {
+		/* RAM */ {
+			.phys_start = 0x3f100000,
+			.virt_start = 0,
+			.size = 0x00100000,
+			.flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_WRITE |
+				JAILHOUSE_MEM_EXECUTE | JAILHOUSE_MEM_LOADABLE,
+		},
+		/* communication region */ {
+			.virt_start = 0x00100000,
+			.size = 0x00001000,
+			.flags = JAILHOUSE_MEM_READ | JAILHOUSE_MEM_WRITE |
+				JAILHOUSE_MEM_COMM_REGION,
+		},
+	},
+
+	.pio_bitmap = {
+		[     0/8 ...  0x2f7/8] = -1,
+		[ 0x2f8/8 ...  0x2ff/8] = 0, /* serial2 */
+		[ 0x300/8 ... 0xdfff/8] = -1,
+		[0xe000/8 ... 0xe007/8] = 0, /* OXPCIe952 serial2 */
+		[0xe008/8 ... 0xffff/8] = -1,
+	},
+};
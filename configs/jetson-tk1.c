@@ -4,7 +4,7 @@
  * Test configuration for Jetson TK1 board
  * (NVIDIA Tegra K1 quad-core Cortex-A15, 2G RAM)
  *
- * Copyright (c) Siemens AG, 2015
+ * Copyright (c) Siemens AG, 2015, 2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -37,6 +37,10 @@ struct {
 			.size = 0x1000,
 			.flags = JAILHOUSE_MEM_IO,
 		},
+		.platform_info.arm = {
+			/* 2 MB 16-way L2 */
+			.cache_colors = 32,
+		},
 		.root_cell = {
 			.name = "Jetson-TK1",
 
@@ -33,13 +33,16 @@ void jailhouse_cell_kobj_release(struct kobject *kobj)
 	struct cell *cell = container_of(kobj, struct cell, kobj);
 
 	jailhouse_pci_cell_cleanup(cell);
+	vfree(cell->page_sizes);
 	vfree(cell->memory_regions);
 	kfree(cell);
 }
 
 static struct cell *cell_create(const struct jailhouse_cell_desc *cell_desc)
 {
+	const struct jailhouse_cache *cache;
 	struct cell *cell;
+	unsigned int n;
 	int err;
 
 	if (cell_desc->num_memory_regions >=
@@ -67,8 +70,25 @@ static struct cell *cell_create(const struct jailhouse_cell_desc *cell_desc)
 	memcpy(cell->memory_regions, jailhouse_cell_mem_regions(cell_desc),
 	       sizeof(struct jailhouse_memory) * cell->num_memory_regions);
 
+	cell->page_sizes = vzalloc(sizeof(int) * cell->num_memory_regions);
+	if (!cell->page_sizes) {
+		vfree(cell->memory_regions);
+		kfree(cell);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	cell->mem_bw_delay = cell_desc->mem_bw_delay;
+
+	cache = jailhouse_cell_cache_regions(cell_desc);
+	for (n = 0; n < cell_desc->num_cache_regions; n++, cache++)
+		if (cache->type == JAILHOUSE_CACHE_L2) {
+			cell->first_color = cache->start;
+			cell->num_colors = cache->size;
+		}
+
 	err = jailhouse_pci_cell_setup(cell, cell_desc);
 	if (err) {
+		vfree(cell->page_sizes);
 		vfree(cell->memory_regions);
 		kfree(cell);
 		return ERR_PTR(err);
@@ -82,6 +102,20 @@ static struct cell *cell_create(const struct jailhouse_cell_desc *cell_desc)
 	return cell;
 }
 
+/*
+ * The page sizes only change when memory is moved between cells, so they are
+ * queried once per change instead of walking the page tables on every read.
+ */
+static void cell_update_page_sizes(struct cell *cell)
+{
+	unsigned int n;
+
+	for (n = 0; n < cell->num_memory_regions; n++)
+		cell->page_sizes[n] =
+			jailhouse_call_arg2(JAILHOUSE_HC_CELL_GET_PAGE_SIZE,
+					    cell->id, n);
+}
+
 static void cell_register(struct cell *cell)
 {
 	list_add_tail(&cell->entry, &cells);
@@ -124,6 +158,7 @@ void jailhouse_cell_register_root(void)
 				     JAILHOUSE_PCI_ACTION_ADD);
 
 	root_cell->id = 0;
+	cell_update_page_sizes(root_cell);
 	cell_register(root_cell);
 }
 
@@ -215,6 +250,8 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg)
 	}
 
 	cell->id = id;
+	cell_update_page_sizes(cell);
+	cell_update_page_sizes(root_cell);
 	cell_register(cell);
 
 	pr_info("Created Jailhouse cell \"%s\"\n", config->name);
@@ -262,14 +299,41 @@ static int cell_management_prologue(struct jailhouse_cell_id *cell_id,
 
 #define MEM_REQ_FLAGS	(JAILHOUSE_MEM_WRITE | JAILHOUSE_MEM_LOADABLE)
 
+/* Size of a memory region as seen by the cell, see JAILHOUSE_MEM_COLORED */
+static u64 region_size(struct cell *cell, const struct jailhouse_memory *mem)
+{
+	if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+		return mem->size;
+	if (jailhouse_cache_colors == 0)
+		return 0;
+	return (unsigned long)mem->size / jailhouse_cache_colors *
+		cell->num_colors;
+}
+
+/* Physical address behind an offset into a memory region of the cell */
+static u64 region_phys_address(struct cell *cell,
+			       const struct jailhouse_memory *mem,
+			       unsigned long offset)
+{
+	unsigned long page = offset >> PAGE_SHIFT;
+
+	if (!(mem->flags & JAILHOUSE_MEM_COLORED))
+		return mem->phys_start + offset;
+	return mem->phys_start + offset_in_page(offset) +
+		((u64)(page / cell->num_colors * jailhouse_cache_colors +
+		       cell->first_color + page % cell->num_colors)
+		 << PAGE_SHIFT);
+}
+
 static int load_image(struct cell *cell,
 		      struct jailhouse_preload_image __user *uimage)
 {
 	struct jailhouse_preload_image image;
 	const struct jailhouse_memory *mem;
-	unsigned int regions, page_offs;
-	u64 image_offset, phys_start;
-	void *image_mem;
+	u64 image_offset, phys_start, phys_end;
+	unsigned long offset, chunk;
+	unsigned int regions;
+	void *image_mem, *target;
 	int err = 0;
 
 	if (copy_from_user(&image, uimage, sizeof(image)))
@@ -282,8 +346,8 @@ static int load_image(struct cell *cell,
 	for (regions = cell->num_memory_regions; regions > 0; regions--) {
 		image_offset = image.target_address - mem->virt_start;
 		if (image.target_address >= mem->virt_start &&
-		    image_offset < mem->size) {
-			if (image.size > mem->size - image_offset ||
+		    image_offset < region_size(cell, mem)) {
+			if (image.size > region_size(cell, mem) - image_offset ||
 			    (mem->flags & MEM_REQ_FLAGS) != MEM_REQ_FLAGS)
 				return -EINVAL;
 			break;
@@ -293,10 +357,15 @@ static int load_image(struct cell *cell,
 	if (regions == 0)
 		return -EINVAL;
 
-	phys_start = (mem->phys_start + image_offset) & PAGE_MASK;
-	page_offs = offset_in_page(image_offset);
+	/*
+	 * Map the physical range covering the image. For colored regions, it
+	 * also includes the pages of other colors that are skipped below.
+	 */
+	phys_start = region_phys_address(cell, mem, image_offset) & PAGE_MASK;
+	phys_end = region_phys_address(cell, mem,
+				       image_offset + image.size - 1) + 1;
 	image_mem = jailhouse_ioremap(phys_start, 0,
-				      PAGE_ALIGN(image.size + page_offs));
+				      PAGE_ALIGN(phys_end - phys_start));
 	if (!image_mem) {
 		pr_err("jailhouse: Unable to map cell RAM at %08llx "
 		       "for image loading\n",
@@ -304,18 +373,31 @@ static int load_image(struct cell *cell,
 		return -EBUSY;
 	}
 
-	if (copy_from_user(image_mem + page_offs,
-			   (void __user *)(unsigned long)image.source_address,
-			   image.size))
-		err = -EFAULT;
-	/*
-	 * ARMv8 requires to clean D-cache and invalidate I-cache for memory
-	 * containing new instructions. On x86 this is a NOP. On ARMv7 the
-	 * firmware does its own cache maintenance, so it is an
-	 * extraneous (but harmless) flush.
-	 */
-	flush_icache_range((unsigned long)(image_mem + page_offs),
-			   (unsigned long)(image_mem + page_offs) + image.size);
+	for (offset = 0; offset < image.size; offset += chunk) {
+		chunk = image.size - offset;
+		if (mem->flags & JAILHOUSE_MEM_COLORED)
+			chunk = min(chunk, PAGE_SIZE -
+				    offset_in_page(image_offset + offset));
+		target = image_mem + (region_phys_address(cell, mem,
+							  image_offset +
+							  offset) -
+				      phys_start);
+
+		if (copy_from_user(target,
+				   (void __user *)(unsigned long)
+				   (image.source_address + offset), chunk)) {
+			err = -EFAULT;
+			break;
+		}
+		/*
+		 * ARMv8 requires to clean D-cache and invalidate I-cache for
+		 * memory containing new instructions. On x86 this is a NOP. On
+		 * ARMv7 the firmware does its own cache maintenance, so it is
+		 * an extraneous (but harmless) flush.
+		 */
+		flush_icache_range((unsigned long)target,
+				   (unsigned long)target + chunk);
+	}
 
 	vunmap(image_mem);
 
@@ -341,6 +423,9 @@ int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg)
 	if (err)
 		goto unlock_out;
 
+	/* the loadable regions are now mapped into the root cell */
+	cell_update_page_sizes(root_cell);
+
 	for (n = cell_load.num_preload_images; n > 0; n--, image++) {
 		err = load_image(cell, image);
 		if (err)
@@ -367,6 +452,8 @@ int jailhouse_cmd_cell_start(const char __user *arg)
 		return err;
 
 	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_START, cell->id);
+	if (err == 0)
+		cell_update_page_sizes(root_cell);
 
 	mutex_unlock(&jailhouse_lock);
 
@@ -395,6 +482,8 @@ static int cell_destroy(struct cell *cell)
 	jailhouse_pci_do_all_devices(cell, JAILHOUSE_PCI_TYPE_DEVICE,
 	                             JAILHOUSE_PCI_ACTION_RELEASE);
 
+	cell_update_page_sizes(root_cell);
+
 	pr_info("Destroyed Jailhouse cell \"%s\"\n",
 		kobject_name(&cell->kobj));
 
@@ -423,6 +512,79 @@ int jailhouse_cmd_cell_destroy(const char __user *arg)
 	return err;
 }
 
+int jailhouse_cmd_cell_set_cache(struct jailhouse_cell_cache __user *arg)
+{
+	struct jailhouse_cell_cache cell_cache;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&cell_cache, arg, sizeof(cell_cache)))
+		return -EFAULT;
+
+	/* the hypercall passes the region in a single argument */
+	if (cell_cache.start > 0xff || cell_cache.size > 0xff ||
+	    cell_cache.type > 0xff || cell_cache.flags > 0xff)
+		return -EINVAL;
+
+	err = cell_management_prologue(&cell_cache.cell_id, &cell);
+	if (err)
+		return err;
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_SET_CACHE, cell->id,
+				  JAILHOUSE_CELL_CACHE_REGION(cell_cache.start,
+							      cell_cache.size,
+							      cell_cache.type,
+							      cell_cache.flags));
+
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
+
+int jailhouse_cmd_cell_get_dirty_log(
+		struct jailhouse_cell_dirty_log __user *arg)
+{
+	struct jailhouse_cell_dirty_log dirty_log;
+	struct jailhouse_dirty_log *log;
+	struct cell *cell;
+	int err;
+
+	if (copy_from_user(&dirty_log, arg, sizeof(dirty_log)))
+		return -EFAULT;
+
+	if (dirty_log.num_pages == 0 ||
+	    dirty_log.num_pages > JAILHOUSE_DIRTY_LOG_MAX_PAGES)
+		return -EINVAL;
+
+	/* the hypervisor expects request and bitmap in a single page */
+	log = (struct jailhouse_dirty_log *)__get_free_page(GFP_KERNEL);
+	if (!log)
+		return -ENOMEM;
+
+	log->start = dirty_log.start;
+	log->num_pages = dirty_log.num_pages;
+	log->flags = dirty_log.flags;
+
+	err = cell_management_prologue(&dirty_log.cell_id, &cell);
+	if (err)
+		goto free_out;
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_GET_DIRTY_LOG, cell->id,
+				  __pa(log));
+
+	mutex_unlock(&jailhouse_lock);
+
+	if (err == 0 &&
+	    copy_to_user((void __user *)(unsigned long)dirty_log.bitmap,
+			 log->bitmap, DIV_ROUND_UP(dirty_log.num_pages, 8)))
+		err = -EFAULT;
+
+free_out:
+	free_page((unsigned long)log);
+
+	return err;
+}
+
 int jailhouse_cmd_cell_destroy_non_root(void)
 {
 	struct cell *cell, *tmp;
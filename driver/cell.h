@@ -29,6 +29,11 @@ struct cell {
 	cpumask_t cpus_assigned;
 	u32 num_memory_regions;
 	struct jailhouse_memory *memory_regions;
+	/* cached result of JAILHOUSE_HC_CELL_GET_PAGE_SIZE per region */
+	int *page_sizes;
+	u32 mem_bw_delay;
+	u32 first_color;
+	u32 num_colors;
 #ifdef CONFIG_PCI
 	u32 num_pci_devices;
 	struct jailhouse_pci_device *pci_devices;
@@ -47,6 +52,9 @@ int jailhouse_cmd_cell_create(struct jailhouse_cell_create __user *arg);
 int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg);
 int jailhouse_cmd_cell_start(const char __user *arg);
 int jailhouse_cmd_cell_destroy(const char __user *arg);
+int jailhouse_cmd_cell_set_cache(struct jailhouse_cell_cache __user *arg);
+int jailhouse_cmd_cell_get_dirty_log(
+		struct jailhouse_cell_dirty_log __user *arg);
 
 int jailhouse_cmd_cell_destroy_non_root(void);
 
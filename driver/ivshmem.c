@@ -0,0 +1,535 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <linux/eventfd.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/pci.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include "ivshmem.h"
+#include "jailhouse.h"
+#include "main.h"
+
+#include <jailhouse/hypercall.h>
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define IVSHMEM_REG_IVPOS	8
+#define IVSHMEM_REG_DBELL	12
+
+#define IVSHMEM_MAX_VECTORS	16
+
+/* mmap layout of the device file */
+#define IVSHMEM_MMAP_REGISTERS	0
+#define IVSHMEM_MMAP_SHMEM	PAGE_SIZE
+
+struct jailhouse_ivshmem;
+
+struct jailhouse_ivshmem_vector {
+	struct jailhouse_ivshmem *ivshmem;
+	struct eventfd_ctx *eventfd;
+};
+
+struct jailhouse_ivshmem {
+	struct kref kref;
+	struct pci_dev *pdev;
+	struct miscdevice misc;
+	char name[32];
+	int id;
+	void __iomem *registers;
+	phys_addr_t shmem_phys;
+	u64 shmem_size;
+	u32 ivpos;
+	/* virtual device of the hypervisor, not e.g. a QEMU ivshmem device */
+	bool jailhouse_device;
+	unsigned int num_vectors;
+	struct msix_entry msix[IVSHMEM_MAX_VECTORS];
+	struct jailhouse_ivshmem_vector vectors[IVSHMEM_MAX_VECTORS];
+	/* protects the eventfd pointers against the interrupt handlers */
+	spinlock_t eventfd_lock;
+	/* serializes file operations against device removal */
+	struct mutex lock;
+	bool removed;
+	atomic_t in_use;
+	/* mappings of the open file, zapped when the device goes away */
+	struct address_space *mapping;
+};
+
+static DEFINE_IDA(jailhouse_ivshmem_ida);
+
+static void jailhouse_ivshmem_free(struct kref *kref)
+{
+	struct jailhouse_ivshmem *ivshmem =
+		container_of(kref, struct jailhouse_ivshmem, kref);
+
+	ida_simple_remove(&jailhouse_ivshmem_ida, ivshmem->id);
+	kfree(ivshmem);
+}
+
+static irqreturn_t jailhouse_ivshmem_irq(int irq, void *arg)
+{
+	struct jailhouse_ivshmem_vector *vector = arg;
+	struct jailhouse_ivshmem *ivshmem = vector->ivshmem;
+
+	spin_lock(&ivshmem->eventfd_lock);
+	if (vector->eventfd)
+		eventfd_signal(vector->eventfd, 1);
+	spin_unlock(&ivshmem->eventfd_lock);
+
+	return IRQ_HANDLED;
+}
+
+static void jailhouse_ivshmem_set_eventfd(struct jailhouse_ivshmem *ivshmem,
+					  unsigned int vector,
+					  struct eventfd_ctx *eventfd)
+{
+	struct eventfd_ctx *old;
+
+	spin_lock_irq(&ivshmem->eventfd_lock);
+	old = ivshmem->vectors[vector].eventfd;
+	ivshmem->vectors[vector].eventfd = eventfd;
+	spin_unlock_irq(&ivshmem->eventfd_lock);
+
+	if (old)
+		eventfd_ctx_put(old);
+}
+
+static int jailhouse_ivshmem_open(struct inode *inode, struct file *file)
+{
+	struct jailhouse_ivshmem *ivshmem =
+		container_of(file->private_data, struct jailhouse_ivshmem,
+			     misc);
+
+	/* eventfds and doorbells are per device, allow only one user */
+	if (atomic_cmpxchg(&ivshmem->in_use, 0, 1) != 0)
+		return -EBUSY;
+
+	kref_get(&ivshmem->kref);
+	file->private_data = ivshmem;
+
+	mutex_lock(&ivshmem->lock);
+	ivshmem->mapping = file->f_mapping;
+	mutex_unlock(&ivshmem->lock);
+
+	return 0;
+}
+
+static int jailhouse_ivshmem_release(struct inode *inode, struct file *file)
+{
+	struct jailhouse_ivshmem *ivshmem = file->private_data;
+	unsigned int n;
+
+	for (n = 0; n < IVSHMEM_MAX_VECTORS; n++)
+		jailhouse_ivshmem_set_eventfd(ivshmem, n, NULL);
+
+	/* all mappings are gone, they hold a file reference */
+	mutex_lock(&ivshmem->lock);
+	ivshmem->mapping = NULL;
+	mutex_unlock(&ivshmem->lock);
+
+	atomic_set(&ivshmem->in_use, 0);
+	kref_put(&ivshmem->kref, jailhouse_ivshmem_free);
+
+	return 0;
+}
+
+static int jailhouse_ivshmem_fault(struct vm_area_struct *vma,
+				   struct vm_fault *vmf)
+{
+	struct jailhouse_ivshmem *ivshmem = vma->vm_file->private_data;
+	unsigned long offset = vmf->pgoff << PAGE_SHIFT;
+	int ret = VM_FAULT_SIGBUS;
+	phys_addr_t phys;
+	int err;
+
+	/*
+	 * Pages are inserted on demand so that a removed device can no longer
+	 * be accessed via mappings that were zapped on removal.
+	 */
+	mutex_lock(&ivshmem->lock);
+
+	if (ivshmem->removed)
+		goto out;
+
+	if (offset < IVSHMEM_MMAP_SHMEM) {
+		phys = pci_resource_start(ivshmem->pdev, 0);
+	} else {
+		offset -= IVSHMEM_MMAP_SHMEM;
+		if (offset >= ivshmem->shmem_size)
+			goto out;
+		phys = ivshmem->shmem_phys + offset;
+	}
+
+	err = vm_insert_pfn(vma, (unsigned long)vmf->virtual_address,
+			    phys >> PAGE_SHIFT);
+	if (err == 0 || err == -EBUSY)
+		ret = VM_FAULT_NOPAGE;
+	else if (err == -ENOMEM)
+		ret = VM_FAULT_OOM;
+
+out:
+	mutex_unlock(&ivshmem->lock);
+	return ret;
+}
+
+static const struct vm_operations_struct jailhouse_ivshmem_vm_ops = {
+	.fault = jailhouse_ivshmem_fault,
+};
+
+static int jailhouse_ivshmem_mmap(struct file *file,
+				  struct vm_area_struct *vma)
+{
+	struct jailhouse_ivshmem *ivshmem = file->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	int err = -EINVAL;
+
+	/* pages are inserted by PFN, there is nothing to copy on write */
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	mutex_lock(&ivshmem->lock);
+
+	if (ivshmem->removed) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	if (offset == IVSHMEM_MMAP_REGISTERS) {
+		/* the registers have to start at the beginning of the page */
+		if (size > PAGE_SIZE ||
+		    offset_in_page(pci_resource_start(ivshmem->pdev, 0)))
+			goto out;
+		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+		vma->vm_flags |= VM_IO;
+	} else if (offset >= IVSHMEM_MMAP_SHMEM) {
+		offset -= IVSHMEM_MMAP_SHMEM;
+		if (offset >= ivshmem->shmem_size ||
+		    size > ivshmem->shmem_size - offset)
+			goto out;
+		/* the shared memory is RAM: default caching and no VM_IO */
+	} else {
+		goto out;
+	}
+
+	vma->vm_flags |= VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_ops = &jailhouse_ivshmem_vm_ops;
+	err = 0;
+
+out:
+	mutex_unlock(&ivshmem->lock);
+	return err;
+}
+
+static int jailhouse_ivshmem_doorbell(struct jailhouse_ivshmem *ivshmem,
+				      u32 value)
+{
+#ifdef CONFIG_X86
+	struct pci_dev *pdev = ivshmem->pdev;
+	int err;
+
+	/*
+	 * The hypercall avoids the decoding of an MMIO access in the
+	 * hypervisor. It must only be issued while the hypervisor is enabled,
+	 * otherwise VMCALL/VMMCALL would raise an invalid opcode exception.
+	 * Do not wait for jailhouse_lock: its holder may be removing this
+	 * device, and the register write is always safe.
+	 */
+	if (ivshmem->jailhouse_device && mutex_trylock(&jailhouse_lock)) {
+		if (jailhouse_enabled) {
+			err = (int)jailhouse_call_arg2(
+				JAILHOUSE_HC_IVSHMEM_DOORBELL,
+				PCI_DEVID(pdev->bus->number, pdev->devfn),
+				value);
+			mutex_unlock(&jailhouse_lock);
+			return err;
+		}
+		mutex_unlock(&jailhouse_lock);
+	}
+#endif
+	writel(value, ivshmem->registers + IVSHMEM_REG_DBELL);
+	return 0;
+}
+
+static long jailhouse_ivshmem_ioctl(struct file *file, unsigned int ioctl,
+				    unsigned long arg)
+{
+	struct jailhouse_ivshmem *ivshmem = file->private_data;
+	struct jailhouse_ivshmem_eventfd eventfd_params;
+	struct jailhouse_ivshmem_info info;
+	struct eventfd_ctx *eventfd = NULL;
+	u32 value;
+	long err;
+
+	mutex_lock(&ivshmem->lock);
+
+	if (ivshmem->removed) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	switch (ioctl) {
+	case JAILHOUSE_IVSHMEM_GET_INFO:
+		memset(&info, 0, sizeof(info));
+		info.shmem_size = ivshmem->shmem_size;
+		info.shmem_offset = IVSHMEM_MMAP_SHMEM;
+		info.registers_offset = IVSHMEM_MMAP_REGISTERS;
+		info.ivpos = ivshmem->ivpos;
+		info.num_vectors = ivshmem->num_vectors;
+		err = copy_to_user((void __user *)arg, &info, sizeof(info)) ?
+			-EFAULT : 0;
+		break;
+	case JAILHOUSE_IVSHMEM_SET_EVENTFD:
+		if (copy_from_user(&eventfd_params, (void __user *)arg,
+				   sizeof(eventfd_params))) {
+			err = -EFAULT;
+			break;
+		}
+		if (eventfd_params.vector >= ivshmem->num_vectors) {
+			err = -EINVAL;
+			break;
+		}
+		if (eventfd_params.fd >= 0) {
+			eventfd = eventfd_ctx_fdget(eventfd_params.fd);
+			if (IS_ERR(eventfd)) {
+				err = PTR_ERR(eventfd);
+				break;
+			}
+		}
+		jailhouse_ivshmem_set_eventfd(ivshmem, eventfd_params.vector,
+					      eventfd);
+		err = 0;
+		break;
+	case JAILHOUSE_IVSHMEM_DOORBELL:
+		if (get_user(value, (u32 __user *)arg)) {
+			err = -EFAULT;
+			break;
+		}
+		err = jailhouse_ivshmem_doorbell(ivshmem, value);
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+out:
+	mutex_unlock(&ivshmem->lock);
+	return err;
+}
+
+static const struct file_operations jailhouse_ivshmem_fops = {
+	.owner = THIS_MODULE,
+	.open = jailhouse_ivshmem_open,
+	.release = jailhouse_ivshmem_release,
+	.mmap = jailhouse_ivshmem_mmap,
+	.unlocked_ioctl = jailhouse_ivshmem_ioctl,
+	.compat_ioctl = jailhouse_ivshmem_ioctl,
+	.llseek = noop_llseek,
+};
+
+static void jailhouse_ivshmem_free_irqs(struct jailhouse_ivshmem *ivshmem)
+{
+	unsigned int n;
+
+	for (n = 0; n < ivshmem->num_vectors; n++)
+		free_irq(ivshmem->msix[n].vector, &ivshmem->vectors[n]);
+	pci_disable_msix(ivshmem->pdev);
+}
+
+static int jailhouse_ivshmem_setup_irqs(struct jailhouse_ivshmem *ivshmem)
+{
+	unsigned int n;
+	int err;
+
+	err = pci_msix_vec_count(ivshmem->pdev);
+	if (err < 0)
+		return err;
+	ivshmem->num_vectors = min(err, IVSHMEM_MAX_VECTORS);
+
+	for (n = 0; n < ivshmem->num_vectors; n++) {
+		ivshmem->msix[n].entry = n;
+		ivshmem->vectors[n].ivshmem = ivshmem;
+	}
+
+	err = pci_enable_msix_range(ivshmem->pdev, ivshmem->msix, 1,
+				    ivshmem->num_vectors);
+	if (err < 0)
+		return err;
+	ivshmem->num_vectors = err;
+
+	for (n = 0; n < ivshmem->num_vectors; n++) {
+		err = request_irq(ivshmem->msix[n].vector,
+				  jailhouse_ivshmem_irq, 0, ivshmem->name,
+				  &ivshmem->vectors[n]);
+		if (err) {
+			ivshmem->num_vectors = n;
+			jailhouse_ivshmem_free_irqs(ivshmem);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static int jailhouse_ivshmem_probe(struct pci_dev *pdev,
+				   const struct pci_device_id *id)
+{
+	struct jailhouse_ivshmem *ivshmem;
+	u32 low, high;
+	int err;
+
+	ivshmem = kzalloc(sizeof(*ivshmem), GFP_KERNEL);
+	if (!ivshmem)
+		return -ENOMEM;
+
+	kref_init(&ivshmem->kref);
+	spin_lock_init(&ivshmem->eventfd_lock);
+	mutex_init(&ivshmem->lock);
+	ivshmem->pdev = pdev;
+
+	err = ida_simple_get(&jailhouse_ivshmem_ida, 0, 0, GFP_KERNEL);
+	if (err < 0) {
+		kfree(ivshmem);
+		return err;
+	}
+	ivshmem->id = err;
+	snprintf(ivshmem->name, sizeof(ivshmem->name), "jailhouse-ivshmem%d",
+		 ivshmem->id);
+
+	err = pci_enable_device(pdev);
+	if (err)
+		goto err_put;
+
+	err = pci_request_regions(pdev, ivshmem->name);
+	if (err)
+		goto err_disable;
+
+	ivshmem->registers = pci_iomap(pdev, 0, 0);
+	if (!ivshmem->registers) {
+		err = -ENOMEM;
+		goto err_release;
+	}
+
+	if (pci_resource_len(pdev, 2) > 0) {
+		/* e.g. QEMU's ivshmem, shared memory in BAR2 */
+		ivshmem->shmem_phys = pci_resource_start(pdev, 2);
+		ivshmem->shmem_size = pci_resource_len(pdev, 2);
+	} else {
+		/* Jailhouse describes the shared memory in config space */
+		pci_read_config_dword(pdev, IVSHMEM_CFG_SHMEM_PTR, &low);
+		pci_read_config_dword(pdev, IVSHMEM_CFG_SHMEM_PTR + 4, &high);
+		ivshmem->shmem_phys = ((u64)high << 32) | low;
+		pci_read_config_dword(pdev, IVSHMEM_CFG_SHMEM_SZ, &low);
+		pci_read_config_dword(pdev, IVSHMEM_CFG_SHMEM_SZ + 4, &high);
+		ivshmem->shmem_size = ((u64)high << 32) | low;
+		ivshmem->jailhouse_device = true;
+	}
+
+	ivshmem->ivpos = readl(ivshmem->registers + IVSHMEM_REG_IVPOS);
+
+	pci_set_master(pdev);
+
+	err = jailhouse_ivshmem_setup_irqs(ivshmem);
+	if (err)
+		goto err_unmap;
+
+	ivshmem->misc.minor = MISC_DYNAMIC_MINOR;
+	ivshmem->misc.name = ivshmem->name;
+	ivshmem->misc.fops = &jailhouse_ivshmem_fops;
+	ivshmem->misc.parent = &pdev->dev;
+	err = misc_register(&ivshmem->misc);
+	if (err)
+		goto err_free_irqs;
+
+	pci_set_drvdata(pdev, ivshmem);
+
+	dev_info(&pdev->dev, "%s: %llu KB shared memory, position %u, "
+		 "%u vectors\n", ivshmem->name, ivshmem->shmem_size >> 10,
+		 ivshmem->ivpos, ivshmem->num_vectors);
+
+	return 0;
+
+err_free_irqs:
+	jailhouse_ivshmem_free_irqs(ivshmem);
+err_unmap:
+	pci_iounmap(pdev, ivshmem->registers);
+err_release:
+	pci_release_regions(pdev);
+err_disable:
+	pci_disable_device(pdev);
+err_put:
+	kref_put(&ivshmem->kref, jailhouse_ivshmem_free);
+	return err;
+}
+
+static void jailhouse_ivshmem_remove(struct pci_dev *pdev)
+{
+	struct jailhouse_ivshmem *ivshmem = pci_get_drvdata(pdev);
+	unsigned int n;
+
+	misc_deregister(&ivshmem->misc);
+
+	/*
+	 * An open file keeps the structure, but it can no longer be used.
+	 * Existing mappings are zapped, new faults on them raise SIGBUS.
+	 */
+	mutex_lock(&ivshmem->lock);
+	ivshmem->removed = true;
+	if (ivshmem->mapping)
+		unmap_mapping_range(ivshmem->mapping, 0, 0, 1);
+	mutex_unlock(&ivshmem->lock);
+
+	jailhouse_ivshmem_free_irqs(ivshmem);
+	for (n = 0; n < IVSHMEM_MAX_VECTORS; n++)
+		jailhouse_ivshmem_set_eventfd(ivshmem, n, NULL);
+
+	pci_iounmap(pdev, ivshmem->registers);
+	pci_release_regions(pdev);
+	pci_disable_device(pdev);
+
+	kref_put(&ivshmem->kref, jailhouse_ivshmem_free);
+}
+
+static const struct pci_device_id jailhouse_ivshmem_ids[] = {
+	{ PCI_DEVICE(PCI_VENDOR_ID_REDHAT_QUMRANET, 0x1110) },
+	{ 0 }
+};
+
+static struct pci_driver jailhouse_ivshmem_driver = {
+	.name		= "jailhouse-ivshmem",
+	.id_table	= jailhouse_ivshmem_ids,
+	.probe		= jailhouse_ivshmem_probe,
+	.remove		= jailhouse_ivshmem_remove,
+};
+
+/**
+ * Register the driver for the ivshmem devices of the root cell.
+ *
+ * @return 0 on success, or error code
+ */
+int jailhouse_ivshmem_register(void)
+{
+	return pci_register_driver(&jailhouse_ivshmem_driver);
+}
+
+/**
+ * Unregister the driver for the ivshmem devices of the root cell.
+ */
+void jailhouse_ivshmem_unregister(void)
+{
+	pci_unregister_driver(&jailhouse_ivshmem_driver);
+}
@@ -0,0 +1,16 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_DRIVER_IVSHMEM_H
+#define _JAILHOUSE_DRIVER_IVSHMEM_H
+
+int jailhouse_ivshmem_register(void);
+void jailhouse_ivshmem_unregister(void);
+
+#endif /* !_JAILHOUSE_DRIVER_IVSHMEM_H */
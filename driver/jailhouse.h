@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013-2015
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -72,11 +72,54 @@ struct jailhouse_cell_load {
 
 #define JAILHOUSE_CELL_ID_UNUSED	(-1)
 
+/* start, size, type and flags as in struct jailhouse_cache */
+struct jailhouse_cell_cache {
+	struct jailhouse_cell_id cell_id;
+	__u32 start;
+	__u32 size;
+	__u32 type;
+	__u32 flags;
+};
+
+struct jailhouse_cell_dirty_log {
+	struct jailhouse_cell_id cell_id;
+	__u64 start;
+	__u32 num_pages;
+	__u32 flags;
+	/* user buffer receiving one bit per page */
+	__u64 bitmap;
+};
+
+struct jailhouse_ivshmem_info {
+	__u64 shmem_size;
+	/* mmap offsets of the shared memory and the register page */
+	__u64 shmem_offset;
+	__u64 registers_offset;
+	__u32 ivpos;
+	__u32 num_vectors;
+};
+
+struct jailhouse_ivshmem_eventfd {
+	__u32 vector;
+	/* -1 detaches the eventfd from the vector */
+	__s32 fd;
+};
+
 #define JAILHOUSE_ENABLE		_IOW(0, 0, void *)
 #define JAILHOUSE_DISABLE		_IO(0, 1)
 #define JAILHOUSE_CELL_CREATE		_IOW(0, 2, struct jailhouse_cell_create)
 #define JAILHOUSE_CELL_LOAD		_IOW(0, 3, struct jailhouse_cell_load)
 #define JAILHOUSE_CELL_START		_IOW(0, 4, struct jailhouse_cell_id)
 #define JAILHOUSE_CELL_DESTROY		_IOW(0, 5, struct jailhouse_cell_id)
+#define JAILHOUSE_CELL_SET_CACHE	_IOW(0, 6, struct jailhouse_cell_cache)
+#define JAILHOUSE_CELL_GET_DIRTY_LOG	\
+	_IOW(0, 7, struct jailhouse_cell_dirty_log)
+
+/* ioctls of the /dev/jailhouse-ivshmem<N> devices */
+#define JAILHOUSE_IVSHMEM_GET_INFO	\
+	_IOR(0, 0x10, struct jailhouse_ivshmem_info)
+#define JAILHOUSE_IVSHMEM_SET_EVENTFD	\
+	_IOW(0, 0x11, struct jailhouse_ivshmem_eventfd)
+#define JAILHOUSE_IVSHMEM_DOORBELL	_IOW(0, 0x12, __u32)
 
 #endif /* !_JAILHOUSE_DRIVER_H */
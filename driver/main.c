@@ -68,6 +68,7 @@ MODULE_VERSION(JAILHOUSE_VERSION);
 
 DEFINE_MUTEX(jailhouse_lock);
 bool jailhouse_enabled;
+unsigned int jailhouse_cache_colors;
 
 static struct device *jailhouse_dev;
 static void *hypervisor_mem;
@@ -297,6 +298,10 @@ static int jailhouse_cmd_enable(struct jailhouse_system __user *arg)
 	if (err)
 		goto error_unmap;
 
+#ifdef CONFIG_ARM
+	jailhouse_cache_colors = config->platform_info.arm.cache_colors;
+#endif
+
 	error_code = 0;
 
 	preempt_disable();
@@ -459,6 +464,14 @@ static long jailhouse_ioctl(struct file *file, unsigned int ioctl,
 	case JAILHOUSE_CELL_DESTROY:
 		err = jailhouse_cmd_cell_destroy((const char __user *)arg);
 		break;
+	case JAILHOUSE_CELL_SET_CACHE:
+		err = jailhouse_cmd_cell_set_cache(
+			(struct jailhouse_cell_cache __user *)arg);
+		break;
+	case JAILHOUSE_CELL_GET_DIRTY_LOG:
+		err = jailhouse_cmd_cell_get_dirty_log(
+			(struct jailhouse_cell_dirty_log __user *)arg);
+		break;
 	default:
 		err = -EINVAL;
 		break;
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2014-2015
+ * Copyright (c) Siemens AG, 2014-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -14,6 +14,7 @@
 #include <linux/pci.h>
 #include <linux/vmalloc.h>
 
+#include "ivshmem.h"
 #include "pci.h"
 
 static int jailhouse_pci_stub_probe(struct pci_dev *dev,
@@ -110,13 +111,24 @@ static void jailhouse_pci_claim_release(const struct jailhouse_pci_device *dev,
 }
 
 /**
- * Register jailhouse as a PCI device driver so it can claim assigned devices.
+ * Register jailhouse as a PCI device driver so it can claim assigned devices
+ * and drive the ivshmem devices of the root cell.
  *
  * @return 0 on success, or error code
  */
 int jailhouse_pci_register(void)
 {
-	return pci_register_driver(&jailhouse_pci_stub_driver);
+	int err;
+
+	err = pci_register_driver(&jailhouse_pci_stub_driver);
+	if (err)
+		return err;
+
+	err = jailhouse_ivshmem_register();
+	if (err)
+		pci_unregister_driver(&jailhouse_pci_stub_driver);
+
+	return err;
 }
 
 /**
@@ -124,6 +136,7 @@ int jailhouse_pci_register(void)
  */
 void jailhouse_pci_unregister(void)
 {
+	jailhouse_ivshmem_unregister();
 	pci_unregister_driver(&jailhouse_pci_stub_driver);
 }
 
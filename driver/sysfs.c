@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2014-2015
+ * Copyright (c) Siemens AG, 2014-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -92,6 +92,28 @@ static ssize_t stats_show(struct kobject *kobj, struct kobj_attribute *attr,
 		.code = _code, \
 	}
 
+static ssize_t cell_info_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buffer)
+{
+	struct jailhouse_cpu_stats_attr *stats_attr =
+		container_of(attr, struct jailhouse_cpu_stats_attr, kattr);
+	struct cell *cell = container_of(kobj, struct cell, kobj);
+	int value;
+
+	value = jailhouse_call_arg2(JAILHOUSE_HC_CELL_GET_INFO, cell->id,
+				    stats_attr->code);
+	if (value < 0)
+		return value;
+
+	return sprintf(buffer, "%d\n", value);
+}
+
+#define JAILHOUSE_CELL_INFO_ATTR(_name, _code) \
+	static struct jailhouse_cpu_stats_attr _name##_attr = { \
+		.kattr = __ATTR(_name, S_IRUGO, cell_info_show, NULL), \
+		.code = _code, \
+	}
+
 JAILHOUSE_CPU_STATS_ATTR(vmexits_total, JAILHOUSE_CPU_STAT_VMEXITS_TOTAL);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_mmio, JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_management,
@@ -107,6 +129,17 @@ JAILHOUSE_CPU_STATS_ATTR(vmexits_cpuid, JAILHOUSE_CPU_STAT_VMEXITS_CPUID);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_xsetbv, JAILHOUSE_CPU_STAT_VMEXITS_XSETBV);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_exception,
 			 JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION);
+JAILHOUSE_CPU_STATS_ATTR(ivshmem_doorbells,
+			 JAILHOUSE_CPU_STAT_IVSHMEM_DOORBELLS);
+JAILHOUSE_CPU_STATS_ATTR(ivshmem_irqs, JAILHOUSE_CPU_STAT_IVSHMEM_IRQS);
+JAILHOUSE_CPU_STATS_ATTR(ivshmem_coalesced,
+			 JAILHOUSE_CPU_STAT_IVSHMEM_COALESCED);
+JAILHOUSE_CPU_STATS_ATTR(vmcs_cache_hits, JAILHOUSE_CPU_STAT_VMCS_CACHE_HITS);
+JAILHOUSE_CELL_INFO_ATTR(l3_occupancy_kb, JAILHOUSE_CELL_INFO_L3_OCCUPANCY);
+JAILHOUSE_CELL_INFO_ATTR(mem_traffic_total_kb,
+			 JAILHOUSE_CELL_INFO_MEM_TRAFFIC_TOTAL);
+JAILHOUSE_CELL_INFO_ATTR(mem_traffic_local_kb,
+			 JAILHOUSE_CELL_INFO_MEM_TRAFFIC_LOCAL);
 #elif defined(CONFIG_ARM)
 JAILHOUSE_CPU_STATS_ATTR(vmexits_maintenance, JAILHOUSE_CPU_STAT_VMEXITS_MAINTENANCE);
 JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_irq, JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
@@ -126,6 +159,13 @@ static struct attribute *no_attrs[] = {
 	&vmexits_cpuid_attr.kattr.attr,
 	&vmexits_xsetbv_attr.kattr.attr,
 	&vmexits_exception_attr.kattr.attr,
+	&ivshmem_doorbells_attr.kattr.attr,
+	&ivshmem_irqs_attr.kattr.attr,
+	&ivshmem_coalesced_attr.kattr.attr,
+	&vmcs_cache_hits_attr.kattr.attr,
+	&l3_occupancy_kb_attr.kattr.attr,
+	&mem_traffic_total_kb_attr.kattr.attr,
+	&mem_traffic_local_kb_attr.kattr.attr,
 #elif defined(CONFIG_ARM)
 	&vmexits_maintenance_attr.kattr.attr,
 	&vmexits_virt_irq_attr.kattr.attr,
@@ -212,17 +252,75 @@ static ssize_t cpus_failed_show(struct kobject *kobj,
 	return written;
 }
 
+static ssize_t memory_page_sizes_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	struct cell *cell = container_of(kobj, struct cell, kobj);
+	const struct jailhouse_memory *mem = cell->memory_regions;
+	unsigned int n;
+	int written = 0;
+
+	/* cached by the cell management, see cell_update_page_sizes */
+	for (n = 0; n < cell->num_memory_regions; n++, mem++) {
+		if (cell->page_sizes[n] < 0)
+			return cell->page_sizes[n];
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "0x%llx-0x%llx %d\n", mem->virt_start,
+				     mem->virt_start + mem->size - 1,
+				     cell->page_sizes[n]);
+	}
+
+	return written;
+}
+
+static ssize_t mem_bw_delay_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buffer)
+{
+	struct cell *cell = container_of(kobj, struct cell, kobj);
+
+	return sprintf(buffer, "%u\n", cell->mem_bw_delay);
+}
+
+static ssize_t mem_bw_delay_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buffer, size_t count)
+{
+	struct cell *cell = container_of(kobj, struct cell, kobj);
+	unsigned int delay;
+	int err;
+
+	err = kstrtouint(buffer, 0, &delay);
+	if (err)
+		return err;
+
+	err = jailhouse_call_arg2(JAILHOUSE_HC_CELL_SET_MEM_BW, cell->id,
+				  delay);
+	if (err)
+		return err;
+
+	cell->mem_bw_delay = delay;
+
+	return count;
+}
+
 static struct kobj_attribute cell_id_attr = __ATTR_RO(id);
 static struct kobj_attribute cell_state_attr = __ATTR_RO(state);
 static struct kobj_attribute cell_cpus_assigned_attr =
 	__ATTR_RO(cpus_assigned);
 static struct kobj_attribute cell_cpus_failed_attr = __ATTR_RO(cpus_failed);
+static struct kobj_attribute cell_memory_page_sizes_attr =
+	__ATTR_RO(memory_page_sizes);
+static struct kobj_attribute cell_mem_bw_delay_attr =
+	__ATTR(mem_bw_delay, S_IRUGO | S_IWUSR, mem_bw_delay_show,
+	       mem_bw_delay_store);
 
 static struct attribute *cell_attrs[] = {
 	&cell_id_attr.attr,
 	&cell_state_attr.attr,
 	&cell_cpus_assigned_attr.attr,
 	&cell_cpus_failed_attr.attr,
+	&cell_memory_page_sizes_attr.attr,
+	&cell_mem_bw_delay_attr.attr,
 	NULL,
 };
 
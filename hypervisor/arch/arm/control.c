@@ -18,6 +18,7 @@
 #include <asm/irqchip.h>
 #include <asm/platform.h>
 #include <asm/processor.h>
+#include <asm/smmu.h>
 #include <asm/sysregs.h>
 #include <asm/traps.h>
 
@@ -342,6 +343,13 @@ int arch_cell_create(struct cell *cell)
 		return err;
 	}
 
+	err = smmu_cell_init(cell);
+	if (err) {
+		irqchip_cell_exit(cell);
+		arch_mmu_cell_destroy(cell);
+		return err;
+	}
+
 	register_smp_ops(cell);
 
 	return 0;
@@ -359,11 +367,36 @@ void arch_cell_destroy(struct cell *cell)
 		arch_reset_cpu(cpu);
 	}
 
+	smmu_cell_exit(cell);
+
 	irqchip_cell_exit(cell);
 
 	arch_mmu_cell_destroy(cell);
 }
 
+int arch_cell_set_mem_bw(struct cell *cell, unsigned long delay)
+{
+	return -ENODEV;
+}
+
+int arch_cell_get_info(struct cell *cell, unsigned long type)
+{
+	return -ENODEV;
+}
+
+int arch_cell_set_cache(struct cell *cell,
+			const struct jailhouse_cache *cache)
+{
+	return -ENODEV;
+}
+
+int arch_cell_get_dirty_log(struct cell *cell, unsigned long start,
+			    unsigned int num_pages, unsigned long flags,
+			    u8 *bitmap)
+{
+	return -ENODEV;
+}
+
 /* Note: only supports synchronous flushing as triggered by config_commit! */
 void arch_flush_cell_vcpu_caches(struct cell *cell)
 {
@@ -378,6 +411,7 @@ void arch_flush_cell_vcpu_caches(struct cell *cell)
 
 void arch_config_commit(struct cell *cell_added_removed)
 {
+	smmu_config_commit();
 }
 
 void __attribute__((noreturn)) arch_panic_stop(void)
@@ -404,6 +438,8 @@ void arch_shutdown(void)
 	 * Let the exit handler call reset_self to let the core finish its
 	 * shutdown function and release its lock.
 	 */
+	smmu_shutdown();
+
 	for_each_cpu(cpu, root_cell.cpu_set)
 		per_cpu(cpu)->shutdown = true;
 }
@@ -30,6 +30,26 @@ extern unsigned int gicd_size;
 
 static DEFINE_SPINLOCK(dist_lock);
 
+/*
+ * Distributor registers that are modified via read-modify-write. Each bank
+ * has its own lock, and the SPI part of it is shadowed: once the hypervisor
+ * is enabled, only this code writes those registers, so cell reads can be
+ * served from the shadow. The SGI/PPI part is banked per CPU and always
+ * accessed directly.
+ */
+struct dist_bank {
+	spinlock_t lock;
+	u32 *shadow;
+};
+
+static u32 igroupr_shadow[1024 / 32];
+static u32 icfgr_shadow[1024 / 16];
+static u32 ipriorityr_shadow[1024 / 4];
+
+static struct dist_bank igroupr_bank = { .shadow = igroupr_shadow };
+static struct dist_bank icfgr_bank = { .shadow = icfgr_shadow };
+static struct dist_bank ipriorityr_bank = { .shadow = ipriorityr_shadow };
+
 /* The GIC interface numbering does not necessarily match the logical map */
 u8 target_cpu_map[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
@@ -49,14 +69,14 @@ bool gic_targets_in_cell(struct cell *cell, u8 targets)
 /*
  * Most of the GIC distributor writes only reconfigure the IRQs corresponding to
  * the bits of the written value, by using separate `set' and `clear' registers.
- * Such registers can be handled by setting the `is_poke' boolean, which allows
- * to simply restrict the mmio->value with the cell configuration mask.
+ * Such registers can be handled by passing no bank, which allows to simply
+ * restrict the mmio->value with the cell configuration mask.
  * Others, such as the priority registers, will need to be read and written back
- * with a restricted value, by using the distributor lock.
+ * with a restricted value, by using the lock and the shadow of their bank.
  */
 static enum mmio_result
 restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
-			unsigned int bits_per_irq, bool is_poke)
+			unsigned int bits_per_irq, struct dist_bank *bank)
 {
 	struct cell *cell = this_cell();
 	unsigned int irq;
@@ -69,41 +89,64 @@ restrict_bitmask_access(struct mmio_access *mmio, unsigned int reg_index,
 	unsigned long irq_bits = (1 << bits_per_irq) - 1;
 	/* First, extract the first interrupt affected by this access */
 	unsigned int first_irq = reg_index * irqs_per_reg;
+	bool shadowed = bank && is_spi(first_irq);
+	/* byte accesses, e.g. to IPRIORITYR, only cover some of the lanes */
+	unsigned int shift = (mmio->address & 0x3) * 8;
+	unsigned long access_val;
+	u32 reg_val;
 
 	for (irq = 0; irq < irqs_per_reg; irq++)
 		if (irqchip_irq_in_cell(cell, first_irq + irq))
 			access_mask |= irq_bits << (irq * bits_per_irq);
+	access_mask = (access_mask >> shift) & BYTE_MASK(mmio->size);
 
 	if (!mmio->is_write) {
 		/* Restrict the read value */
-		mmio_perform_access(gicd_base, mmio);
+		if (shadowed)
+			mmio->value = bank->shadow[reg_index] >> shift;
+		else
+			mmio_perform_access(gicd_base, mmio);
 		mmio->value &= access_mask;
 		return MMIO_HANDLED;
 	}
 
-	if (!is_poke) {
-		/*
-		 * Modify the existing value of this register by first reading
-		 * it into mmio->value
-		 * Relies on a spinlock since we need two mmio accesses.
-		 */
-		unsigned long access_val = mmio->value;
+	if (!bank) {
+		mmio->value &= access_mask;
+		mmio_perform_access(gicd_base, mmio);
+		return MMIO_HANDLED;
+	}
 
-		spin_lock(&dist_lock);
+	/*
+	 * Modify the existing value of this register, taken from the shadow
+	 * or by reading it into mmio->value. Relies on the bank lock since
+	 * other cells may update their IRQs in the same register.
+	 */
+	access_val = mmio->value;
+
+	spin_lock(&bank->lock);
 
+	if (shadowed) {
+		/* update the lanes in the shadow, then write the whole word */
+		reg_val = bank->shadow[reg_index];
+		reg_val &= ~(access_mask << shift);
+		reg_val |= (access_val & access_mask) << shift;
+		bank->shadow[reg_index] = reg_val;
+
+		mmio->address &= ~0x3;
+		mmio->size = 4;
+		mmio->value = reg_val;
+	} else {
 		mmio->is_write = false;
 		mmio_perform_access(gicd_base, mmio);
 		mmio->is_write = true;
 
 		mmio->value &= ~access_mask;
 		mmio->value |= access_val & access_mask;
-		mmio_perform_access(gicd_base, mmio);
-
-		spin_unlock(&dist_lock);
-	} else {
-		mmio->value &= access_mask;
-		mmio_perform_access(gicd_base, mmio);
 	}
+	mmio_perform_access(gicd_base, mmio);
+
+	spin_unlock(&bank->lock);
+
 	return MMIO_HANDLED;
 }
 
@@ -276,20 +319,22 @@ enum mmio_result gic_handle_dist_access(void *arg, struct mmio_access *mmio)
 	case REG_RANGE(GICD_ISPENDR, 32, 4):
 	case REG_RANGE(GICD_ICACTIVER, 32, 4):
 	case REG_RANGE(GICD_ISACTIVER, 32, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, true);
+		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, NULL);
 		break;
 
 	case REG_RANGE(GICD_IGROUPR, 32, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1, false);
+		ret = restrict_bitmask_access(mmio, (reg & 0x7f) / 4, 1,
+					      &igroupr_bank);
 		break;
 
 	case REG_RANGE(GICD_ICFGR, 64, 4):
-		ret = restrict_bitmask_access(mmio, (reg & 0xff) / 4, 2, false);
+		ret = restrict_bitmask_access(mmio, (reg & 0xff) / 4, 2,
+					      &icfgr_bank);
 		break;
 
 	case REG_RANGE(GICD_IPRIORITYR, 255, 4):
 		ret = restrict_bitmask_access(mmio, (reg & 0x3ff) / 4, 8,
-					      false);
+					      &ipriorityr_bank);
 		break;
 
 	case GICD_SGIR:
@@ -314,6 +359,61 @@ enum mmio_result gic_handle_dist_access(void *arg, struct mmio_access *mmio)
 	return ret;
 }
 
+/*
+ * Load the SPI configuration left behind by Linux into the distributor
+ * shadow. Must be called before the first cell access is trapped.
+ */
+void gic_dist_shadow_init(void)
+{
+	unsigned int num_irqs, n;
+
+	num_irqs = ((mmio_read32(gicd_base + GICD_TYPER) &
+		     GICD_TYPER_ITLINESNUMBER) + 1) * 32;
+
+	for (n = 32 / 32; n < num_irqs / 32; n++)
+		igroupr_shadow[n] = mmio_read32(gicd_base + GICD_IGROUPR +
+						n * 4);
+	for (n = 32 / 16; n < num_irqs / 16; n++)
+		icfgr_shadow[n] = mmio_read32(gicd_base + GICD_ICFGR + n * 4);
+	for (n = 32 / 4; n < num_irqs / 4; n++)
+		ipriorityr_shadow[n] = mmio_read32(gicd_base +
+						   GICD_IPRIORITYR + n * 4);
+}
+
+/*
+ * The list register shadow avoids reading back list registers on injection.
+ * The guest can only complete interrupts and thereby free list registers,
+ * it never fills them. Thus, an entry that is free in the shadow is free in
+ * hardware as well, while used entries may be stale. Drivers drop the latter
+ * from lr_used according to ELSR before relying on them.
+ */
+bool gic_lr_shadow_contains(struct per_cpu *cpu_data, u16 irq_id)
+{
+	u64 used = cpu_data->lr_used;
+	unsigned int n;
+
+	for (n = 0; used != 0; n++, used >>= 1)
+		if ((used & 1) && cpu_data->lr_irq[n] == irq_id)
+			return true;
+	return false;
+}
+
+int gic_lr_shadow_get_free(struct per_cpu *cpu_data, unsigned int num_lr)
+{
+	unsigned int n;
+
+	for (n = 0; n < num_lr; n++)
+		if (!(cpu_data->lr_used & (1ULL << n)))
+			return n;
+	return -1;
+}
+
+void gic_lr_shadow_set(struct per_cpu *cpu_data, unsigned int lr, u16 irq_id)
+{
+	cpu_data->lr_irq[lr] = irq_id;
+	cpu_data->lr_used |= 1ULL << lr;
+}
+
 void gic_handle_irq(struct per_cpu *cpu_data)
 {
 	bool handled = false;
@@ -54,6 +54,7 @@ static void gic_clear_pending_irqs(void)
 	/* Clear list registers. */
 	for (n = 0; n < gic_num_lr; n++)
 		gic_write_lr(n, 0);
+	this_cpu_data()->lr_used = 0;
 
 	/* Clear active priority bits. */
 	mmio_write32(gich_base + GICH_APR, 0);
@@ -238,31 +239,38 @@ static int gic_send_sgi(struct sgi *sgi)
 	return 0;
 }
 
+static void gic_sync_lr_shadow(struct per_cpu *cpu_data)
+{
+	u64 elsr = mmio_read32(gich_base + GICH_ELSR0);
+
+	if (gic_num_lr > 32)
+		elsr |= (u64)mmio_read32(gich_base + GICH_ELSR1) << 32;
+
+	/* drop entries the guest has completed in the meantime */
+	cpu_data->lr_used &= ~elsr;
+}
+
 static int gic_inject_irq(struct per_cpu *cpu_data, u16 irq_id)
 {
-	int i;
-	int first_free = -1;
+	int first_free;
 	u32 lr;
-	unsigned long elsr[2];
-
-	elsr[0] = mmio_read32(gich_base + GICH_ELSR0);
-	elsr[1] = mmio_read32(gich_base + GICH_ELSR1);
-	for (i = 0; i < gic_num_lr; i++) {
-		if (test_bit(i, elsr)) {
-			/* Entry is available */
-			if (first_free == -1)
-				first_free = i;
-			continue;
-		}
+
+	/*
+	 * Only consult the hardware if the shadow suggests that the IRQ is
+	 * already queued or that all list registers are in use.
+	 */
+	first_free = gic_lr_shadow_get_free(cpu_data, gic_num_lr);
+	if (first_free == -1 || gic_lr_shadow_contains(cpu_data, irq_id)) {
+		gic_sync_lr_shadow(cpu_data);
 
 		/* Check that there is no overlapping */
-		lr = gic_read_lr(i);
-		if ((lr & GICH_LR_VIRT_ID_MASK) == irq_id)
+		if (gic_lr_shadow_contains(cpu_data, irq_id))
 			return -EEXIST;
-	}
 
-	if (first_free == -1)
-		return -EBUSY;
+		first_free = gic_lr_shadow_get_free(cpu_data, gic_num_lr);
+		if (first_free == -1)
+			return -EBUSY;
+	}
 
 	/* Inject group 0 interrupt (seen as IRQ by the guest) */
 	lr = irq_id;
@@ -274,6 +282,7 @@ static int gic_inject_irq(struct per_cpu *cpu_data, u16 irq_id)
 	}
 
 	gic_write_lr(first_free, lr);
+	gic_lr_shadow_set(cpu_data, first_free, irq_id);
 
 	return 0;
 }
@@ -59,6 +59,7 @@ static void gic_clear_pending_irqs(void)
 	/* Clear list registers. */
 	for (n = 0; n < gic_num_lr; n++)
 		gic_write_lr(n, 0);
+	this_cpu_data()->lr_used = 0;
 
 	/* Clear active priority bits */
 	if (gic_num_priority_bits >= 5)
@@ -368,39 +369,39 @@ static void gic_eoi_irq(u32 irq_id, bool deactivate)
 		arm_write_sysreg(ICC_DIR_EL1, irq_id);
 }
 
-static int gic_inject_irq(struct per_cpu *cpu_data, u16 irq_id)
+static void gic_sync_lr_shadow(struct per_cpu *cpu_data)
 {
-	int i;
-	int free_lr = -1;
 	u32 elsr;
-	u64 lr;
 
 	arm_read_sysreg(ICH_ELSR_EL2, elsr);
-	for (i = 0; i < gic_num_lr; i++) {
-		if ((elsr >> i) & 1) {
-			/* Entry is invalid, candidate for injection */
-			if (free_lr == -1)
-				free_lr = i;
-			continue;
-		}
 
-		/*
-		 * Entry is in use, check that it doesn't match the one we want
-		 * to inject.
-		 */
-		lr = gic_read_lr(i);
-
-		/*
-		 * A strict phys->virt id mapping is used for SPIs, so this test
-		 * should be sufficient.
-		 */
-		if ((u32)lr == irq_id)
+	/* drop entries the guest has completed in the meantime */
+	cpu_data->lr_used &= ~(u64)elsr;
+}
+
+static int gic_inject_irq(struct per_cpu *cpu_data, u16 irq_id)
+{
+	int free_lr;
+	u64 lr;
+
+	/*
+	 * Only consult the hardware if the shadow suggests that the IRQ is
+	 * already queued or that all list registers are in use.
+	 * A strict phys->virt id mapping is used for SPIs, so comparing the
+	 * virtual IDs is sufficient.
+	 */
+	free_lr = gic_lr_shadow_get_free(cpu_data, gic_num_lr);
+	if (free_lr == -1 || gic_lr_shadow_contains(cpu_data, irq_id)) {
+		gic_sync_lr_shadow(cpu_data);
+
+		if (gic_lr_shadow_contains(cpu_data, irq_id))
 			return -EEXIST;
-	}
 
-	if (free_lr == -1)
-		/* All list registers are in use */
-		return -EBUSY;
+		free_lr = gic_lr_shadow_get_free(cpu_data, gic_num_lr);
+		if (free_lr == -1)
+			/* All list registers are in use */
+			return -EBUSY;
+	}
 
 	lr = irq_id;
 	/* Only group 1 interrupts */
@@ -412,6 +413,7 @@ static int gic_inject_irq(struct per_cpu *cpu_data, u16 irq_id)
 	}
 
 	gic_write_lr(free_lr, lr);
+	gic_lr_shadow_set(cpu_data, free_lr, irq_id);
 
 	return 0;
 }
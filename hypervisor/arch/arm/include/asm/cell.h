@@ -34,6 +34,14 @@ struct arch_cell {
 	u32 irq_bitmap[1024/32];
 
 	unsigned int last_virt_id;
+
+	/** First L2 page color of the cell. */
+	unsigned int first_color;
+	/** Number of L2 page colors, 0 if the cell has no color set. */
+	unsigned int num_colors;
+
+	/** Stage-2 mappings were removed since the last SMMU TLB flush. */
+	bool smmu_needs_flush;
 };
 
 /** PCI-related cell states. */
@@ -19,6 +19,7 @@
 #define GICD_CTLR			0x0000
 # define GICD_CTLR_ARE_NS		(1 << 4)
 #define GICD_TYPER			0x0004
+# define GICD_TYPER_ITLINESNUMBER	0x1f
 #define GICD_IIDR			0x0008
 #define GICD_IGROUPR			0x0080
 #define GICD_ISENABLER			0x0100
@@ -52,6 +53,7 @@ struct sgi;
 extern u8 target_cpu_map[];
 
 int gic_probe_cpu_id(unsigned int cpu);
+void gic_dist_shadow_init(void);
 enum mmio_result gic_handle_dist_access(void *arg, struct mmio_access *mmio);
 enum mmio_result gic_handle_irq_route(struct mmio_access *mmio,
 				      unsigned int irq);
@@ -59,5 +61,9 @@ void gic_handle_sgir_write(struct sgi *sgi, bool virt_input);
 void gic_handle_irq(struct per_cpu *cpu_data);
 bool gic_targets_in_cell(struct cell *cell, u8 targets);
 
+bool gic_lr_shadow_contains(struct per_cpu *cpu_data, u16 irq_id);
+int gic_lr_shadow_get_free(struct per_cpu *cpu_data, unsigned int num_lr);
+void gic_lr_shadow_set(struct per_cpu *cpu_data, unsigned int lr, u16 irq_id);
+
 #endif /* !__ASSEMBLY__ */
 #endif /* !_JAILHOUSE_ASM_GIC_COMMON_H */
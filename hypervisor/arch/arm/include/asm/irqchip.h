@@ -13,7 +13,8 @@
 #ifndef _JAILHOUSE_ASM_IRQCHIP_H
 #define _JAILHOUSE_ASM_IRQCHIP_H
 
-#define MAX_PENDING_IRQS	256
+#define MAX_PENDING_IRQS	1024
+#define MAX_LIST_REGS		64
 
 #include <jailhouse/cell.h>
 #include <jailhouse/mmio.h>
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -40,14 +40,19 @@ struct per_cpu {
 	unsigned int cpu_id;
 	unsigned int virt_id;
 
-	/* synchronizes parallel insertions of SGIs into the pending ring */
-	spinlock_t pending_irqs_lock;
-	u16 pending_irqs[MAX_PENDING_IRQS];
-	unsigned int pending_irqs_head;
-	/* removal from the ring happens lockless, thus tail is volatile */
-	volatile unsigned int pending_irqs_tail;
+	/*
+	 * Bitmap of virtual IRQs waiting for a free list register, indexed by
+	 * IRQ ID. Any CPU may set bits atomically, only the owner clears them.
+	 */
+	unsigned long pending_irqs[MAX_PENDING_IRQS / BITS_PER_LONG];
 	/* Only GICv3: redistributor base */
 	void *gicr_base;
+	/*
+	 * Shadow of the list registers: virtual IRQ written to each entry and
+	 * bitmap of entries that may still be in use, see gic_lr_shadow_*
+	 */
+	u16 lr_irq[MAX_LIST_REGS];
+	u64 lr_used;
 
 	struct cell *cell;
 
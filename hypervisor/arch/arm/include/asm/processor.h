@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -46,6 +46,14 @@
 
 #define PFR1_VIRT(pfr)		((pfr) >> 12 & 0xf)
 
+#define CLIDR_CTYPE(clidr, level)	((clidr) >> (((level) - 1) * 3) & 0x7)
+#define CLIDR_CTYPE_DATA		2
+
+#define CSSELR_LEVEL(level)		(((level) - 1) << 1)
+
+#define CCSIDR_LINE_SIZE(ccsidr)	(16 << ((ccsidr) & 0x7))
+#define CCSIDR_NUM_SETS(ccsidr)		((((ccsidr) >> 13) & 0x7fff) + 1)
+
 #define SCTLR_M_BIT	(1 << 0)
 #define SCTLR_A_BIT	(1 << 1)
 #define SCTLR_C_BIT	(1 << 2)
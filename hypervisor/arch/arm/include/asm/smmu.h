@@ -0,0 +1,21 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_ASM_SMMU_H
+#define _JAILHOUSE_ASM_SMMU_H
+
+#include <jailhouse/cell.h>
+
+int smmu_init(void);
+int smmu_cell_init(struct cell *cell);
+void smmu_cell_exit(struct cell *cell);
+void smmu_config_commit(void);
+void smmu_shutdown(void);
+
+#endif /* !_JAILHOUSE_ASM_SMMU_H */
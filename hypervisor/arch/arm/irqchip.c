@@ -17,6 +17,7 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
+#include <asm/bitops.h>
 #include <asm/control.h>
 #include <asm/gic_common.h>
 #include <asm/irqchip.h>
@@ -54,27 +55,24 @@ bool irqchip_irq_in_cell(struct cell *cell, unsigned int irq_id)
 void irqchip_set_pending(struct per_cpu *cpu_data, u16 irq_id)
 {
 	bool local_injection = (this_cpu_data() == cpu_data);
-	unsigned int new_tail;
 
-	if (local_injection && irqchip.inject_irq(cpu_data, irq_id) != -EBUSY)
+	/* the pending bitmap covers all valid GIC interrupt IDs */
+	if (irq_id >= MAX_PENDING_IRQS) {
+		printk("WARNING: Dropping invalid IRQ %d\n", irq_id);
 		return;
-
-	spin_lock(&cpu_data->pending_irqs_lock);
-
-	new_tail = (cpu_data->pending_irqs_tail + 1) % MAX_PENDING_IRQS;
-
-	/* Queue space available? */
-	if (new_tail != cpu_data->pending_irqs_head) {
-		cpu_data->pending_irqs[cpu_data->pending_irqs_tail] = irq_id;
-		cpu_data->pending_irqs_tail = new_tail;
-		/*
-		 * Make the change to pending_irqs_tail visible before the
-		 * caller sends SGI_INJECT.
-		 */
-		memory_barrier();
 	}
 
-	spin_unlock(&cpu_data->pending_irqs_lock);
+	if (local_injection && irqchip.inject_irq(cpu_data, irq_id) != -EBUSY)
+		return;
+
+	/*
+	 * Setting the bit is atomic, so concurrent injections from other CPUs
+	 * do not need to synchronize. Repeated injections of an IRQ that is
+	 * still pending are merged.
+	 */
+	set_bit(irq_id, cpu_data->pending_irqs);
+	/* Make the pending bit visible before the caller sends SGI_INJECT. */
+	memory_barrier();
 
 	/*
 	 * The list registers are full, trigger maintenance interrupt if we are
@@ -87,27 +85,35 @@ void irqchip_set_pending(struct per_cpu *cpu_data, u16 irq_id)
 
 void irqchip_inject_pending(struct per_cpu *cpu_data)
 {
-	u16 irq_id;
-
-	while (cpu_data->pending_irqs_head != cpu_data->pending_irqs_tail) {
-		irq_id = cpu_data->pending_irqs[cpu_data->pending_irqs_head];
-
-		if (irqchip.inject_irq(cpu_data, irq_id) == -EBUSY) {
-			/*
-			 * The list registers are full, trigger maintenance
-			 * interrupt and leave.
-			 */
-			irqchip.enable_maint_irq(true);
-			return;
+	volatile unsigned long *pending;
+	unsigned long word, bit;
+	unsigned int n;
+
+	/* Drain in ascending IRQ ID order, i.e. SGIs and PPIs first. */
+	for (n = 0; n < ARRAY_SIZE(cpu_data->pending_irqs); n++) {
+		pending = &cpu_data->pending_irqs[n];
+		while ((word = *pending) != 0) {
+			bit = ffsl(word);
+			/* Only this CPU clears bits, others may only set them. */
+			clear_bit(bit, pending);
+
+			if (irqchip.inject_irq(cpu_data, n * BITS_PER_LONG +
+					       bit) == -EBUSY) {
+				/*
+				 * The list registers are full, keep the IRQ
+				 * pending, trigger maintenance interrupt and
+				 * leave.
+				 */
+				set_bit(bit, pending);
+				irqchip.enable_maint_irq(true);
+				return;
+			}
 		}
-
-		cpu_data->pending_irqs_head =
-			(cpu_data->pending_irqs_head + 1) % MAX_PENDING_IRQS;
 	}
 
 	/*
-	 * The software interrupt queue is empty - turn off the maintenance
-	 * interrupt.
+	 * No software interrupts are pending anymore - turn off the
+	 * maintenance interrupt.
 	 */
 	irqchip.enable_maint_irq(false);
 }
@@ -134,7 +140,7 @@ int irqchip_cpu_init(struct per_cpu *cpu_data)
 
 void irqchip_cpu_reset(struct per_cpu *cpu_data)
 {
-	cpu_data->pending_irqs_head = cpu_data->pending_irqs_tail = 0;
+	memset(cpu_data->pending_irqs, 0, sizeof(cpu_data->pending_irqs));
 
 	irqchip.cpu_reset(cpu_data, false);
 }
@@ -264,6 +270,8 @@ int irqchip_init(void)
 	}
 
 	if (irqchip.init) {
+		gic_dist_shadow_init();
+
 		err = irqchip.init();
 		irqchip_is_init = true;
 
@@ -16,6 +16,49 @@
 #include <asm/sysregs.h>
 #include <asm/control.h>
 
+/* L2 way size: each way contains one page of each color */
+static unsigned long color_block_size(void)
+{
+	return system_config->platform_info.arm.cache_colors * PAGE_SIZE;
+}
+
+/* Size of a colored region as seen by the cell */
+static unsigned long colored_size(struct cell *cell,
+				  const struct jailhouse_memory *mem)
+{
+	return (mem->size >> ffsl(color_block_size())) *
+		cell->arch.num_colors * PAGE_SIZE;
+}
+
+/*
+ * Maps the pages of the cell's colors from each block of the region, see
+ * JAILHOUSE_MEM_COLORED.
+ */
+static int map_colored_region(struct cell *cell,
+			      const struct jailhouse_memory *mem, u32 flags)
+{
+	unsigned long block_size = color_block_size();
+	unsigned long chunk_size = cell->arch.num_colors * PAGE_SIZE;
+	unsigned long virt = mem->virt_start;
+	u64 phys = mem->phys_start + cell->arch.first_color * PAGE_SIZE;
+	u64 phys_end = mem->phys_start + mem->size;
+	int err;
+
+	if (cell->arch.num_colors == 0 ||
+	    mem->flags & (JAILHOUSE_MEM_IO | JAILHOUSE_MEM_COMM_REGION) ||
+	    (mem->phys_start | mem->size) & (block_size - 1))
+		return trace_error(-EINVAL);
+
+	for (; phys < phys_end; phys += block_size, virt += chunk_size) {
+		err = paging_create(&cell->arch.mm, phys, chunk_size, virt,
+				    flags, PAGING_NON_COHERENT);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 int arch_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem)
 {
@@ -37,6 +80,9 @@ int arch_map_memory_region(struct cell *cell,
 		flags |= S2_PAGE_ACCESS_XN;
 	*/
 
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return map_colored_region(cell, mem, flags);
+
 	return paging_create(&cell->arch.mm, phys_start, mem->size,
 		mem->virt_start, flags, PAGING_NON_COHERENT);
 }
@@ -44,10 +90,24 @@ int arch_map_memory_region(struct cell *cell,
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 {
-	return paging_destroy(&cell->arch.mm, mem->virt_start, mem->size,
+	unsigned long size = mem->size;
+
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		size = colored_size(cell, mem);
+
+	/* SMMU TLBs are invalidated in one go on config commit. */
+	cell->arch.smmu_needs_flush = true;
+
+	return paging_destroy(&cell->arch.mm, mem->virt_start, size,
 			PAGING_NON_COHERENT);
 }
 
+const struct paging_structures *
+arch_get_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.mm;
+}
+
 unsigned long arch_paging_gphys2phys(struct per_cpu *cpu_data,
 				     unsigned long gphys, unsigned long flags)
 {
@@ -55,8 +115,42 @@ unsigned long arch_paging_gphys2phys(struct per_cpu *cpu_data,
 	return paging_virt2phys(&cpu_data->cell->arch.mm, gphys, flags);
 }
 
+/* The color set is an L2 cache region, counting in page colors. */
+static int parse_cache_colors(struct cell *cell)
+{
+	const struct jailhouse_cache *cache =
+		jailhouse_cell_cache_regions(cell->config);
+
+	cell->arch.first_color = cell->arch.num_colors = 0;
+
+	if (cell->config->num_cache_regions == 0)
+		return 0;
+
+	/* the root cell has to keep its 1:1 mapping */
+	if (cell == &root_cell || cell->config->num_cache_regions > 1 ||
+	    cache->type != JAILHOUSE_CACHE_L2 || cache->size == 0 ||
+	    cache->start + cache->size >
+	    system_config->platform_info.arm.cache_colors)
+		return trace_error(-EINVAL);
+
+	cell->arch.first_color = cache->start;
+	cell->arch.num_colors = cache->size;
+
+	printk("Using cache colors %d-%d for cell \"%s\"\n",
+	       cache->start, cache->start + cache->size - 1,
+	       cell->config->name);
+
+	return 0;
+}
+
 int arch_mmu_cell_init(struct cell *cell)
 {
+	int err;
+
+	err = parse_cache_colors(cell);
+	if (err)
+		return err;
+
 	cell->arch.mm.root_paging = cell_paging;
 	cell->arch.mm.root_table =
 		page_alloc_aligned(&mem_pool, ARM_CELL_ROOT_PT_SZ);
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -14,9 +14,11 @@
 #include <asm/irqchip.h>
 #include <asm/percpu.h>
 #include <asm/setup.h>
+#include <asm/smmu.h>
 #include <asm/sysregs.h>
 #include <jailhouse/control.h>
 #include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
 #include <jailhouse/string.h>
 
@@ -39,6 +41,37 @@ static int arch_check_features(void)
 	return 0;
 }
 
+static int arch_check_cache_colors(void)
+{
+	unsigned int colors = system_config->platform_info.arm.cache_colors;
+	u32 clidr, csselr, ccsidr, way_size;
+
+	if (colors == 0)
+		return 0;
+	if (colors & (colors - 1))
+		return trace_error(-EINVAL);
+
+	/* only warn about a mismatch, the configuration may be intended */
+	arm_read_sysreg(CLIDR_EL1, clidr);
+	if (CLIDR_CTYPE(clidr, 2) < CLIDR_CTYPE_DATA) {
+		printk("WARNING: Cache coloring configured, but no L2 cache\n");
+		return 0;
+	}
+
+	arm_read_sysreg(CSSELR_EL1, csselr);
+	arm_write_sysreg(CSSELR_EL1, CSSELR_LEVEL(2));
+	isb();
+	arm_read_sysreg(CSSIDR_EL1, ccsidr);
+	arm_write_sysreg(CSSELR_EL1, csselr);
+
+	way_size = CCSIDR_NUM_SETS(ccsidr) * CCSIDR_LINE_SIZE(ccsidr);
+	if (way_size / PAGE_SIZE != colors)
+		printk("WARNING: %d cache colors configured, L2 provides %d\n",
+		       colors, way_size / PAGE_SIZE);
+
+	return 0;
+}
+
 int arch_init_early(void)
 {
 	int err = 0;
@@ -46,6 +79,10 @@ int arch_init_early(void)
 	if ((err = arch_check_features()) != 0)
 		return err;
 
+	err = arch_check_cache_colors();
+	if (err)
+		return err;
+
 	return arch_mmu_cell_init(&root_cell);
 }
 
@@ -102,6 +139,10 @@ int arch_init_late(void)
 	if (err)
 		return err;
 
+	err = smmu_init();
+	if (err)
+		return err;
+
 	/* Platform-specific SMP operations */
 	register_smp_ops(&root_cell);
 
@@ -0,0 +1,363 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/mmio.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <asm/paging.h>
+#include <asm/setup.h>
+#include <asm/smmu.h>
+
+/*
+ * SMMUv2 support for stage-2-only DMA isolation. Each cell that lists stream
+ * IDs gets a context bank that uses the cell's stage-2 page tables and its
+ * VMID. As long as only the root cell exists, streams that are not assigned
+ * to any cell bypass the SMMU, just like before the hypervisor was enabled.
+ * Once a non-root cell exists, they fault. The root cell therefore has to list
+ * the streams of all its DMA masters before other cells can be created. The
+ * hypervisor takes over the complete SMMU, so Linux must not use it in the
+ * root cell.
+ */
+
+/* global register space 0 */
+#define SMMU_sCR0			0x000
+# define SMMU_sCR0_CLIENTPD		(1 << 0)
+# define SMMU_sCR0_USFCFG		(1 << 10)
+#define SMMU_sIDR0			0x020
+# define SMMU_sIDR0_S2TS		(1 << 30)
+# define SMMU_sIDR0_SMS			(1 << 27)
+# define SMMU_sIDR0_NUMSMRG(idr)	((idr) & 0xff)
+#define SMMU_sIDR1			0x024
+# define SMMU_sIDR1_PAGESIZE		(1 << 31)
+# define SMMU_sIDR1_NUMPAGENDXB(idr)	(((idr) >> 28) & 0x7)
+# define SMMU_sIDR1_NUMCB(idr)		((idr) & 0xff)
+#define SMMU_TLBIVMID			0x064
+#define SMMU_TLBIALLNSNH		0x068
+#define SMMU_sTLBGSYNC			0x070
+#define SMMU_sTLBGSTATUS		0x074
+# define SMMU_sTLBGSTATUS_GSACTIVE	(1 << 0)
+#define SMMU_SMR(n)			(0x800 + (n) * 4)
+# define SMMU_SMR_VALID			(1 << 31)
+# define SMMU_SMR_ID_MASK		0x7fff
+#define SMMU_S2CR(n)			(0xc00 + (n) * 4)
+# define SMMU_S2CR_TYPE_TRANS		(0 << 16)
+# define SMMU_S2CR_TYPE_BYPASS		(1 << 16)
+
+/* global register space 1 */
+#define SMMU_CBAR(n)			((n) * 4)
+# define SMMU_CBAR_TYPE_S2		(0 << 16)
+
+/* context bank */
+#define SMMU_CB_SCTLR			0x000
+# define SMMU_CB_SCTLR_M		(1 << 0)
+#define SMMU_CB_TTBR0_LO		0x020
+#define SMMU_CB_TTBR0_HI		0x024
+#define SMMU_CB_TCR			0x030
+
+#define SMMU_MAX_SMRS			128
+#define SMMU_MAX_CBS			128
+
+static void *smmu_base;
+static void *smmu_gr1;
+static void *smmu_cbs;
+static unsigned long smmu_page_size;
+static unsigned int smmu_num_smrs, smmu_num_cbs;
+static unsigned int smmu_num_cells;
+static u32 linux_scr0;
+
+static struct cell *smr_owner[SMMU_MAX_SMRS];
+static u16 smr_stream_id[SMMU_MAX_SMRS];
+static struct cell *cb_owner[SMMU_MAX_CBS];
+
+static void *smmu_cb_reg(unsigned int cb, unsigned int reg)
+{
+	return smmu_cbs + cb * smmu_page_size + reg;
+}
+
+static void smmu_tlb_sync(void)
+{
+	mmio_write32(smmu_base + SMMU_sTLBGSYNC, 0);
+	while (mmio_read32(smmu_base + SMMU_sTLBGSTATUS) &
+	       SMMU_sTLBGSTATUS_GSACTIVE)
+		cpu_relax();
+}
+
+static int smmu_find_cb(struct cell *cell)
+{
+	unsigned int n;
+
+	for (n = 0; n < smmu_num_cbs; n++)
+		if (cb_owner[n] == cell)
+			return n;
+	return -1;
+}
+
+static int smmu_find_smr(u32 stream_id)
+{
+	unsigned int n;
+
+	for (n = 0; n < smmu_num_smrs; n++)
+		if (smr_owner[n] && smr_stream_id[n] == stream_id)
+			return n;
+	return -1;
+}
+
+static int smmu_find_smr_free(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < smmu_num_smrs; n++)
+		if (!smr_owner[n])
+			return n;
+	return -1;
+}
+
+static bool stream_id_in_cell(struct cell *cell, u32 stream_id)
+{
+	const u32 *stream_ids = jailhouse_cell_stream_ids(cell->config);
+	unsigned int n;
+
+	for (n = 0; n < cell->config->num_stream_ids; n++)
+		if (stream_ids[n] == stream_id)
+			return true;
+	return false;
+}
+
+static void smmu_set_smr(unsigned int smr, struct cell *cell, u32 stream_id)
+{
+	int cb = cell ? smmu_find_cb(cell) : -1;
+
+	if (cb < 0) {
+		mmio_write32(smmu_base + SMMU_SMR(smr), 0);
+		mmio_write32(smmu_base + SMMU_S2CR(smr),
+			     SMMU_S2CR_TYPE_BYPASS);
+		smr_owner[smr] = NULL;
+		return;
+	}
+
+	mmio_write32(smmu_base + SMMU_S2CR(smr), SMMU_S2CR_TYPE_TRANS | cb);
+	mmio_write32(smmu_base + SMMU_SMR(smr), SMMU_SMR_VALID | stream_id);
+	smr_owner[smr] = cell;
+	smr_stream_id[smr] = stream_id;
+}
+
+static void smmu_set_unmatched_fault(bool fault)
+{
+	u32 cr0 = mmio_read32(smmu_base + SMMU_sCR0) & ~SMMU_sCR0_USFCFG;
+
+	if (fault)
+		cr0 |= SMMU_sCR0_USFCFG;
+	mmio_write32(smmu_base + SMMU_sCR0, cr0);
+}
+
+/* Streams return to the root cell if it lists them, else bypass. */
+static void smmu_release_streams(struct cell *cell)
+{
+	unsigned int n;
+	int cb;
+
+	for (n = 0; n < smmu_num_smrs; n++)
+		if (smr_owner[n] == cell)
+			smmu_set_smr(n, cell != &root_cell &&
+				     stream_id_in_cell(&root_cell,
+						       smr_stream_id[n]) ?
+				     &root_cell : NULL, smr_stream_id[n]);
+
+	cb = smmu_find_cb(cell);
+	if (cb < 0)
+		return;
+
+	mmio_write32(smmu_cb_reg(cb, SMMU_CB_SCTLR), 0);
+	mmio_write32(smmu_base + SMMU_TLBIVMID, cell->id);
+	smmu_tlb_sync();
+	cb_owner[cb] = NULL;
+}
+
+static int smmu_claim_streams(struct cell *cell)
+{
+	const u32 *stream_ids = jailhouse_cell_stream_ids(cell->config);
+	unsigned long cell_table;
+	unsigned int n;
+	int cb, smr;
+
+	if (cell->id > 0xff)
+		return trace_error(-E2BIG);
+
+	for (n = 0; n < cell->config->num_stream_ids; n++) {
+		if (stream_ids[n] > SMMU_SMR_ID_MASK)
+			return trace_error(-EINVAL);
+		smr = smmu_find_smr(stream_ids[n]);
+		if (smr >= 0 && smr_owner[smr] != &root_cell)
+			return trace_error(-EBUSY);
+	}
+
+	cb = smmu_find_cb(NULL);
+	if (cb < 0)
+		return trace_error(-EBUSY);
+
+	/* The context bank shares the stage-2 tables of the CPUs. */
+	cell_table = paging_hvirt2phys(cell->arch.mm.root_table);
+	mmio_write32(smmu_gr1 + SMMU_CBAR(cb), SMMU_CBAR_TYPE_S2 | cell->id);
+	mmio_write32(smmu_cb_reg(cb, SMMU_CB_TTBR0_LO), cell_table);
+	mmio_write32(smmu_cb_reg(cb, SMMU_CB_TTBR0_HI), 0);
+	mmio_write32(smmu_cb_reg(cb, SMMU_CB_TCR), VTCR_CELL);
+	mmio_write32(smmu_cb_reg(cb, SMMU_CB_SCTLR), SMMU_CB_SCTLR_M);
+	cb_owner[cb] = cell;
+
+	/* Take the streams over from the root cell or claim a free SMR. */
+	for (n = 0; n < cell->config->num_stream_ids; n++) {
+		smr = smmu_find_smr(stream_ids[n]);
+		if (smr < 0)
+			smr = smmu_find_smr_free();
+		if (smr < 0) {
+			smmu_release_streams(cell);
+			return trace_error(-EBUSY);
+		}
+		smmu_set_smr(smr, cell, stream_ids[n]);
+	}
+
+	return 0;
+}
+
+int smmu_init(void)
+{
+	unsigned long base = system_config->platform_info.arm.smmu_base;
+	unsigned long size = system_config->platform_info.arm.smmu_size;
+	unsigned long global_size;
+	unsigned int n;
+	u32 idr0, idr1;
+	int err;
+
+	if (base == 0)
+		return 0;
+
+	err = arch_map_device((void *)base, (void *)base, size);
+	if (err)
+		return err;
+	smmu_base = (void *)base;
+
+	idr0 = mmio_read32(smmu_base + SMMU_sIDR0);
+	idr1 = mmio_read32(smmu_base + SMMU_sIDR1);
+	if (!(idr0 & SMMU_sIDR0_S2TS) || !(idr0 & SMMU_sIDR0_SMS))
+		return trace_error(-ENODEV);
+
+	smmu_page_size = (idr1 & SMMU_sIDR1_PAGESIZE) ? 0x10000 : 0x1000;
+	global_size = smmu_page_size << (SMMU_sIDR1_NUMPAGENDXB(idr1) + 1);
+	if (size < 2 * global_size)
+		return trace_error(-EINVAL);
+
+	smmu_gr1 = smmu_base + smmu_page_size;
+	smmu_cbs = smmu_base + global_size;
+	smmu_num_smrs = SMMU_sIDR0_NUMSMRG(idr0);
+	if (smmu_num_smrs > SMMU_MAX_SMRS)
+		smmu_num_smrs = SMMU_MAX_SMRS;
+	smmu_num_cbs = SMMU_sIDR1_NUMCB(idr1);
+	if (smmu_num_cbs > SMMU_MAX_CBS)
+		smmu_num_cbs = SMMU_MAX_CBS;
+
+	/* Drop what Linux may have set up, letting all streams bypass. */
+	for (n = 0; n < smmu_num_smrs; n++)
+		smmu_set_smr(n, NULL, 0);
+	for (n = 0; n < smmu_num_cbs; n++)
+		mmio_write32(smmu_cb_reg(n, SMMU_CB_SCTLR), 0);
+	mmio_write32(smmu_base + SMMU_TLBIALLNSNH, 0);
+	smmu_tlb_sync();
+
+	/* restored on shutdown, Linux may have disabled the SMMU */
+	linux_scr0 = mmio_read32(smmu_base + SMMU_sCR0);
+	mmio_write32(smmu_base + SMMU_sCR0,
+		     linux_scr0 & ~(SMMU_sCR0_CLIENTPD | SMMU_sCR0_USFCFG));
+
+	printk("SMMU: %d stream mapping groups, %d context banks\n",
+	       smmu_num_smrs, smmu_num_cbs);
+
+	return smmu_cell_init(&root_cell);
+}
+
+int smmu_cell_init(struct cell *cell)
+{
+	int err;
+
+	if (!smmu_base)
+		return cell->config->num_stream_ids > 0 ?
+			trace_error(-ENODEV) : 0;
+
+	/* DMA of streams the root cell does not list must not bypass */
+	if (cell != &root_cell && root_cell.config->num_stream_ids == 0)
+		return trace_error(-EINVAL);
+
+	if (cell->config->num_stream_ids > 0) {
+		err = smmu_claim_streams(cell);
+		if (err)
+			return err;
+	}
+
+	if (cell != &root_cell && smmu_num_cells++ == 0)
+		smmu_set_unmatched_fault(true);
+
+	return 0;
+}
+
+void smmu_cell_exit(struct cell *cell)
+{
+	if (!smmu_base)
+		return;
+
+	smmu_release_streams(cell);
+
+	if (cell != &root_cell && --smmu_num_cells == 0)
+		smmu_set_unmatched_fault(false);
+}
+
+/*
+ * Unmapping memory from a cell only marks it, so that a config change costs
+ * one invalidation and synchronization for all regions and cells.
+ */
+void smmu_config_commit(void)
+{
+	bool sync = false;
+	struct cell *cell;
+
+	for_each_cell(cell) {
+		if (!cell->arch.smmu_needs_flush)
+			continue;
+		cell->arch.smmu_needs_flush = false;
+
+		if (smmu_base && smmu_find_cb(cell) >= 0) {
+			if (!sync) {
+				/* Page table updates must precede the TLBI. */
+				dsb(ish);
+				sync = true;
+			}
+			mmio_write32(smmu_base + SMMU_TLBIVMID, cell->id);
+		}
+	}
+
+	if (sync)
+		smmu_tlb_sync();
+}
+
+void smmu_shutdown(void)
+{
+	unsigned int n;
+
+	if (!smmu_base)
+		return;
+
+	for (n = 0; n < smmu_num_smrs; n++)
+		if (smr_owner[n])
+			smmu_set_smr(n, NULL, 0);
+	for (n = 0; n < smmu_num_cbs; n++)
+		mmio_write32(smmu_cb_reg(n, SMMU_CB_SCTLR), 0);
+	mmio_write32(smmu_base + SMMU_TLBIALLNSNH, 0);
+	smmu_tlb_sync();
+
+	mmio_write32(smmu_base + SMMU_sCR0, linux_scr0);
+}
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -304,6 +304,9 @@ void apic_clear(void)
 	if (maxlvt >= 6)
 		apic_mask_lvt(APIC_REG_LVTCMCI);
 	apic_mask_lvt(APIC_REG_LVTT);
+	/* The cell may have left the TSC deadline armed */
+	if (cpuid_ecx(1, 0) & X86_FEATURE_TSC_DEADLINE)
+		write_msr(MSR_IA32_TSC_DEADLINE, 0);
 	if (maxlvt >= 5)
 		apic_mask_lvt(APIC_REG_LVTTHMR);
 	if (maxlvt >= 4)
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2015
+ * Copyright (c) Siemens AG, 2015, 2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -17,6 +17,14 @@ int cat_init(void)
 	return 0;
 }
 
+void cat_cpu_init(struct per_cpu *cpu_data)
+{
+}
+
+void cat_cpu_restore(struct per_cpu *cpu_data)
+{
+}
+
 void cat_update(void)
 {
 }
@@ -29,3 +37,19 @@ int cat_cell_init(struct cell *cell)
 void cat_cell_exit(struct cell *cell)
 {
 }
+
+int cat_cell_set_mem_bw(struct cell *cell, unsigned long delay)
+{
+	return -ENODEV;
+}
+
+int cat_cell_get_info(struct cell *cell, unsigned long type)
+{
+	return -ENODEV;
+}
+
+int cat_cell_set_cache(struct cell *cell,
+		       const struct jailhouse_cache *cache)
+{
+	return -ENODEV;
+}
@@ -12,8 +12,10 @@
 
 #include <jailhouse/control.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/string.h>
 #include <jailhouse/utils.h>
 #include <asm/cat.h>
+#include <asm/control.h>
 
 #include <jailhouse/cell-config.h>
 
@@ -22,20 +24,124 @@
 static unsigned int cbm_max, freed_mask;
 static int cos_max = -1;
 static u64 orig_root_mask;
+static bool cdp_enabled;
+static int mba_cos_max = -1;
+static unsigned int mba_max_delay;
+static int rmid_max = -1;
+static unsigned int cmt_events, cmt_upscale;
+static u64 mbm_counter_mask;
+static DEFINE_SPINLOCK(cmt_lock);
+
+static void cat_update_cell(struct cell *cell)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, cell->cpu_set)
+		if (cpu == this_cpu_id()) {
+			cat_update();
+		} else {
+			per_cpu(cpu)->update_cat = true;
+			x86_kick_cpu(per_cpu(cpu));
+		}
+}
+
+static bool l3_cat_supported(void)
+{
+	return cpuid_ebx(7, 0) & X86_FEATURE_CAT &&
+		cpuid_ebx(0x10, 0) & (1 << CAT_RESID_L3);
+}
+
+static bool l3_cdp_supported(void)
+{
+	return cpuid_ecx(0x10, CAT_RESID_L3) & CAT_CDP_SUPPORTED;
+}
+
+void cat_cpu_init(struct per_cpu *cpu_data)
+{
+	if (!l3_cat_supported())
+		return;
+
+	/*
+	 * Save what Linux uses for COS0. With code/data prioritization, the
+	 * mask MSRs are used in pairs. Switch to that layout only once here,
+	 * cat_update then just programs the masks.
+	 */
+	if (l3_cdp_supported()) {
+		cpu_data->linux_l3_qos_cfg = read_msr(MSR_IA32_L3_QOS_CFG);
+		cpu_data->linux_l3_mask[1] = read_msr(MSR_IA32_L3_MASK_0 + 1);
+		write_msr(MSR_IA32_L3_QOS_CFG, cpu_data->linux_l3_qos_cfg |
+			  L3_QOS_CFG_CDP_ENABLE);
+	}
+	cpu_data->linux_l3_mask[0] = read_msr(MSR_IA32_L3_MASK_0);
+	cpu_data->l3_qos_saved = true;
+}
+
+void cat_cpu_restore(struct per_cpu *cpu_data)
+{
+	if (!cpu_data->l3_qos_saved)
+		return;
+
+	/* the mask layout has to be switched back before restoring them */
+	if (l3_cdp_supported()) {
+		write_msr(MSR_IA32_L3_QOS_CFG, cpu_data->linux_l3_qos_cfg);
+		write_msr(MSR_IA32_L3_MASK_0 + 1, cpu_data->linux_l3_mask[1]);
+	}
+	write_msr(MSR_IA32_L3_MASK_0, cpu_data->linux_l3_mask[0]);
+	/* Linux does not throttle COS0 */
+	if (mba_cos_max >= 0)
+		write_msr(MSR_IA32_MBA_THRTL_0, 0);
+	cpu_data->l3_qos_saved = false;
+}
 
 int cat_init(void)
 {
 	int err;
 
-	if (cpuid_ebx(7, 0) & X86_FEATURE_CAT &&
-	    cpuid_ebx(0x10, 0) & (1 << CAT_RESID_L3)) {
+	if (l3_cat_supported()) {
 		cbm_max = cpuid_eax(0x10, CAT_RESID_L3) & CAT_CBM_LEN_MASK;
 		cos_max = cpuid_edx(0x10, CAT_RESID_L3) & CAT_COS_MAX_MASK;
+
+		/*
+		 * With code/data prioritization, each COS uses a pair of mask
+		 * MSRs, halving the number of available classes. cat_cpu_init
+		 * already enabled it.
+		 */
+		if (l3_cdp_supported()) {
+			cdp_enabled = true;
+			cos_max = (cos_max + 1) / 2 - 1;
+		}
+
+		if (cpuid_ebx(0x10, 0) & (1 << CAT_RESID_MBA)) {
+			mba_max_delay = (cpuid_eax(0x10, CAT_RESID_MBA) &
+					 MBA_MAX_DELAY_MASK) + 1;
+			mba_cos_max = cpuid_edx(0x10, CAT_RESID_MBA) &
+				CAT_COS_MAX_MASK;
+			printk("MBA: %s throttling, maximum delay %d\n",
+			       cpuid_ecx(0x10, CAT_RESID_MBA) & MBA_LINEAR ?
+			       "linear" : "non-linear", mba_max_delay);
+		}
+	}
+
+	if (cpuid_ebx(7, 0) & X86_FEATURE_CMT &&
+	    cpuid_edx(0xf, 0) & (1 << CMT_RESID_L3)) {
+		rmid_max = cpuid_ecx(0xf, CMT_RESID_L3);
+		cmt_upscale = cpuid_ebx(0xf, CMT_RESID_L3);
+		/* bit n reports the availability of event n + 1 */
+		cmt_events = cpuid_edx(0xf, CMT_RESID_L3) << 1;
+		mbm_counter_mask = BIT_MASK(CMT_MBM_WIDTH_BASE - 1 +
+					    (cpuid_eax(0xf, CMT_RESID_L3) &
+					     CMT_MBM_WIDTH_OFFSET_MASK), 0);
+		printk("CMT: %d RMIDs, events %x\n", rmid_max + 1,
+		       cmt_events);
 	}
 
 	err = cat_cell_init(&root_cell);
 	orig_root_mask = root_cell.arch.cat_mask;
 
+	/* Apply the root cell settings on all its CPUs. */
+	if (!err && cos_max >= 0)
+		cat_update_cell(&root_cell);
+
 	return err;
 }
 
@@ -44,20 +150,107 @@ void cat_update(void)
 	struct cell *cell = this_cell();
 
 	write_msr(MSR_IA32_PQR_ASSOC,
-		  (u64)cell->arch.cos << PQR_ASSOC_COS_SHIFT);
-	write_msr(MSR_IA32_L3_MASK_0 + cell->arch.cos, cell->arch.cat_mask);
+		  (u64)cell->arch.cos << PQR_ASSOC_COS_SHIFT | cell->arch.rmid);
+	if (cos_max < 0)
+		return;
+
+	/* cells without an own COS share the settings of the root cell */
+	if (cell->arch.cos == CAT_ROOT_COS)
+		cell = &root_cell;
+
+	if (cdp_enabled) {
+		write_msr(MSR_IA32_L3_MASK_0 + cell->arch.cos * 2,
+			  cell->arch.cat_mask);
+		write_msr(MSR_IA32_L3_MASK_0 + cell->arch.cos * 2 + 1,
+			  cell->arch.cat_code_mask);
+	} else {
+		write_msr(MSR_IA32_L3_MASK_0 + cell->arch.cos,
+			  cell->arch.cat_mask);
+	}
+	if (mba_cos_max >= 0 && cell->arch.cos <= mba_cos_max)
+		write_msr(MSR_IA32_MBA_THRTL_0 + cell->arch.cos,
+			  cell->arch.mba_delay);
 }
 
-/* root cell has to be stopped */
-static void cat_update_cell(struct cell *cell)
+static u32 get_free_rmid(void)
 {
-	unsigned int cpu;
+	struct cell *cell;
+	u32 rmid = 0;
 
-	for_each_cpu(cpu, cell->cpu_set)
-		if (cpu == this_cpu_id())
-			cat_update();
-		else
-			per_cpu(cpu)->update_cat = true;
+retry:
+	for_each_cell(cell)
+		if (cell->arch.rmid == rmid) {
+			rmid++;
+			goto retry;
+		}
+
+	return rmid;
+}
+
+/* Returns the raw counter value or a negative error code */
+static long cmt_read_counter(struct cell *cell, unsigned int event)
+{
+	u64 ctr;
+
+	if (!(cmt_events & (1 << event)))
+		return -ENODEV;
+	if (cell != &root_cell && cell->arch.rmid == 0)
+		return -EBUSY;
+
+	write_msr(MSR_IA32_QM_EVTSEL,
+		  (u64)cell->arch.rmid << QM_EVTSEL_RMID_SHIFT | event);
+	ctr = read_msr(MSR_IA32_QM_CTR);
+	if (ctr & (QM_CTR_ERROR | QM_CTR_UNAVAILABLE))
+		return -EIO;
+
+	return ctr & QM_CTR_DATA_MASK;
+}
+
+/* cmt_lock has to be held */
+static long mbm_sample(struct cell *cell, unsigned int event)
+{
+	unsigned int n = event - CMT_EVENT_MBM_TOTAL;
+	long ctr = cmt_read_counter(cell, event);
+
+	if (ctr < 0)
+		return ctr;
+
+	/*
+	 * The counters wrap around at their width. Accumulating the deltas
+	 * is only precise if they are sampled at least once per period.
+	 */
+	cell->arch.mbm_bytes[n] += ((ctr - cell->arch.mbm_last[n]) &
+				    mbm_counter_mask) * cmt_upscale;
+	cell->arch.mbm_last[n] = ctr;
+
+	return 0;
+}
+
+static void cmt_cell_init(struct cell *cell)
+{
+	cell->arch.rmid = 0;
+	if (rmid_max < 0)
+		return;
+
+	/* the root cell always uses RMID 0 */
+	if (cell != &root_cell) {
+		cell->arch.rmid = get_free_rmid();
+		if (cell->arch.rmid > rmid_max) {
+			printk("CMT: No RMID left, not monitoring cell %s\n",
+			       cell->config->name);
+			cell->arch.rmid = 0;
+			return;
+		}
+	}
+
+	/* start accumulating from the current counter values */
+	spin_lock(&cmt_lock);
+	memset(cell->arch.mbm_bytes, 0, sizeof(cell->arch.mbm_bytes));
+	memset(cell->arch.mbm_last, 0, sizeof(cell->arch.mbm_last));
+	mbm_sample(cell, CMT_EVENT_MBM_TOTAL);
+	mbm_sample(cell, CMT_EVENT_MBM_LOCAL);
+	memset(cell->arch.mbm_bytes, 0, sizeof(cell->arch.mbm_bytes));
+	spin_unlock(&cmt_lock);
 }
 
 static u32 get_free_cos(void)
@@ -94,6 +287,9 @@ restart:
 			goto restart;
 		}
 
+	/* the root cell always uses a unified mask */
+	root_cell.arch.cat_code_mask = root_cell.arch.cat_mask;
+
 	return updated;
 }
 
@@ -140,6 +336,8 @@ static bool shrink_root_cell_mask(u64 cell_mask)
 		}
 	}
 
+	root_cell.arch.cat_code_mask = root_cell.arch.cat_mask;
+
 	printk("CAT: Shrunk root cell bitmask to %08x\n",
 	       root_cell.arch.cat_mask);
 	cat_update_cell(&root_cell);
@@ -150,14 +348,126 @@ static bool shrink_root_cell_mask(u64 cell_mask)
 	return true;
 }
 
+static int cache_region_mask(const struct jailhouse_cache *cache, u64 *mask,
+			     u64 *exclusive_mask)
+{
+	if (cache->size == 0 || (cache->start + cache->size) > cbm_max)
+		return trace_error(-EINVAL);
+
+	*mask = BIT_MASK(cache->start + cache->size - 1, cache->start);
+	*exclusive_mask =
+		(cache->flags & JAILHOUSE_CACHE_ROOTSHARED) ? 0 : *mask;
+
+	return 0;
+}
+
+/*
+ * Either a single unified L3 region or, with CDP, one L3 code and one L3 data
+ * region.
+ */
+static int parse_cache_regions(struct cell *cell)
+{
+	const struct jailhouse_cache *cache =
+		jailhouse_cell_cache_regions(cell->config);
+	bool split = cell->config->num_cache_regions == 2;
+	u64 mask, exclusive_mask;
+	unsigned int n;
+	int err;
+
+	if (cell->config->num_cache_regions > 2 ||
+	    (split && (!cdp_enabled || cell == &root_cell)))
+		return trace_error(-EINVAL);
+
+	cell->arch.cat_mask = cell->arch.cat_code_mask = 0;
+	cell->arch.cat_exclusive_mask = cell->arch.cat_code_exclusive_mask = 0;
+
+	for (n = 0; n < cell->config->num_cache_regions; n++, cache++) {
+		err = cache_region_mask(cache, &mask, &exclusive_mask);
+		if (err)
+			return err;
+
+		if (cache->type == JAILHOUSE_CACHE_L3 && !split) {
+			cell->arch.cat_mask = cell->arch.cat_code_mask = mask;
+			cell->arch.cat_exclusive_mask =
+				cell->arch.cat_code_exclusive_mask =
+				exclusive_mask;
+		} else if (cache->type == JAILHOUSE_CACHE_L3_DATA && split &&
+			   cell->arch.cat_mask == 0) {
+			cell->arch.cat_mask = mask;
+			cell->arch.cat_exclusive_mask = exclusive_mask;
+		} else if (cache->type == JAILHOUSE_CACHE_L3_CODE && split &&
+			   cell->arch.cat_code_mask == 0) {
+			cell->arch.cat_code_mask = mask;
+			cell->arch.cat_code_exclusive_mask = exclusive_mask;
+		} else {
+			return trace_error(-EINVAL);
+		}
+	}
+
+	return 0;
+}
+
+static void print_cell_masks(struct cell *cell)
+{
+	if (cell->arch.cat_code_mask != cell->arch.cat_mask)
+		printk("CAT: Using COS %d with code bitmask %08x and data "
+		       "bitmask %08x for cell %s\n", cell->arch.cos,
+		       cell->arch.cat_code_mask, cell->arch.cat_mask,
+		       cell->config->name);
+	else
+		printk("CAT: Using COS %d with bitmask %08x for cell %s\n",
+		       cell->arch.cos, cell->arch.cat_mask,
+		       cell->config->name);
+}
+
+/*
+ * Memory bandwidth throttling applies per COS, so it requires an own cache
+ * partition, except for the root cell that always owns COS0.
+ */
+static int mba_check_delay(struct cell *cell, unsigned long delay)
+{
+	if (delay == 0)
+		return 0;
+	if (mba_cos_max < 0)
+		return -ENODEV;
+	if (cell != &root_cell && cell->arch.cos == CAT_ROOT_COS)
+		return trace_error(-EINVAL);
+	if (cell->arch.cos > mba_cos_max)
+		return trace_error(-EBUSY);
+	if (delay > mba_max_delay)
+		return trace_error(-EINVAL);
+	return 0;
+}
+
+static int mba_cell_init(struct cell *cell)
+{
+	int err = mba_check_delay(cell, cell->config->mem_bw_delay);
+
+	cell->arch.mba_delay = 0;
+
+	/* like cache regions, the setting is ignored if MBA is unsupported */
+	if (err == -ENODEV)
+		return 0;
+	if (err == 0)
+		cell->arch.mba_delay = cell->config->mem_bw_delay;
+
+	return err;
+}
+
 int cat_cell_init(struct cell *cell)
 {
-	const struct jailhouse_cache *cache;
+	u64 exclusive_mask;
+	int err;
 
 	cell->arch.cos = CAT_ROOT_COS;
 
-	if (cos_max < 0)
+	cmt_cell_init(cell);
+
+	if (cos_max < 0) {
+		if (cell->arch.rmid != 0)
+			cat_update_cell(cell);
 		return 0;
+	}
 
 	if (cell->config->num_cache_regions > 0) {
 		if (cell != &root_cell) {
@@ -166,20 +476,19 @@ int cat_cell_init(struct cell *cell)
 				return trace_error(-EBUSY);
 		}
 
-		cache = jailhouse_cell_cache_regions(cell->config);
-
-		if (cell->config->num_cache_regions != 1 ||
-		    cache->type != JAILHOUSE_CACHE_L3 ||
-		    cache->size == 0 || (cache->start + cache->size) > cbm_max)
-			return trace_error(-EINVAL);
+		err = parse_cache_regions(cell);
+		if (err)
+			return err;
 
-		cell->arch.cat_mask =
-			BIT_MASK(cache->start + cache->size - 1, cache->start);
+		err = mba_cell_init(cell);
+		if (err)
+			return err;
 
+		exclusive_mask = cell->arch.cat_exclusive_mask |
+			cell->arch.cat_code_exclusive_mask;
 		if (cell != &root_cell &&
-		    !(cache->flags & JAILHOUSE_CACHE_ROOTSHARED) &&
-		    (root_cell.arch.cat_mask & cell->arch.cat_mask) != 0)
-			if (!shrink_root_cell_mask(cell->arch.cat_mask))
+		    (root_cell.arch.cat_mask & exclusive_mask) != 0)
+			if (!shrink_root_cell_mask(exclusive_mask))
 				return trace_error(-EINVAL);
 
 		cat_update_cell(cell);
@@ -191,16 +500,141 @@ int cat_cell_init(struct cell *cell)
 		 */
 		cell->arch.cat_mask = (cell == &root_cell) ?
 			BIT_MASK(cbm_max, 0) : root_cell.arch.cat_mask;
+		cell->arch.cat_code_mask = cell->arch.cat_mask;
+
+		err = mba_cell_init(cell);
+		if (err)
+			return err;
+	}
+
+	print_cell_masks(cell);
+	if (cell->arch.mba_delay)
+		printk("MBA: Using delay %d for COS %d\n",
+		       cell->arch.mba_delay, cell->arch.cos);
+
+	return 0;
+}
+
+int cat_cell_set_mem_bw(struct cell *cell, unsigned long delay)
+{
+	int err;
+
+	if (mba_cos_max < 0)
+		return -ENODEV;
+
+	err = mba_check_delay(cell, delay);
+	if (err)
+		return err;
+
+	cell->arch.mba_delay = delay;
+	printk("MBA: Using delay %ld for COS %d\n", delay, cell->arch.cos);
+	cat_update_cell(cell);
+
+	return 0;
+}
+
+/*
+ * Replaces the data, the code or both partitions of a cell that owns a COS.
+ * The new partition must not overlap with what other cells use exclusively,
+ * and its exclusive part must not be used by other cells at all. The root
+ * cell is shrunk or extended accordingly, just like on cell creation and
+ * destruction.
+ */
+int cat_cell_set_cache(struct cell *cell, const struct jailhouse_cache *cache)
+{
+	u64 data_mask = cell->arch.cat_mask;
+	u64 code_mask = cell->arch.cat_code_mask;
+	u64 data_exclusive = cell->arch.cat_exclusive_mask;
+	u64 code_exclusive = cell->arch.cat_code_exclusive_mask;
+	u64 mask, exclusive_mask, old_exclusive, others_mask = 0,
+	    others_exclusive = 0;
+	unsigned int old_freed_mask = freed_mask;
+	struct cell *other;
+	int err;
+
+	if (cos_max < 0)
+		return -ENODEV;
+
+	/* the root cell's mask is derived from the other cells */
+	if (cell == &root_cell || cell->arch.cos == CAT_ROOT_COS ||
+	    cache->flags & ~JAILHOUSE_CACHE_ROOTSHARED)
+		return trace_error(-EINVAL);
+
+	err = cache_region_mask(cache, &mask, &exclusive_mask);
+	if (err)
+		return err;
+
+	if (cache->type == JAILHOUSE_CACHE_L3) {
+		data_mask = code_mask = mask;
+		data_exclusive = code_exclusive = exclusive_mask;
+	} else if (cache->type == JAILHOUSE_CACHE_L3_DATA && cdp_enabled) {
+		data_mask = mask;
+		data_exclusive = exclusive_mask;
+	} else if (cache->type == JAILHOUSE_CACHE_L3_CODE && cdp_enabled) {
+		code_mask = mask;
+		code_exclusive = exclusive_mask;
+	} else {
+		return trace_error(-EINVAL);
 	}
 
-	printk("CAT: Using COS %d with bitmask %08x for cell %s\n",
-	       cell->arch.cos, cell->arch.cat_mask, cell->config->name);
+	for_each_cell(other)
+		if (other != cell && other->arch.cos != CAT_ROOT_COS) {
+			others_mask |= other->arch.cat_mask |
+				other->arch.cat_code_mask;
+			others_exclusive |= other->arch.cat_exclusive_mask |
+				other->arch.cat_code_exclusive_mask;
+		}
+
+	exclusive_mask = data_exclusive | code_exclusive;
+	if ((data_mask | code_mask) & others_exclusive ||
+	    exclusive_mask & others_mask)
+		return trace_error(-EBUSY);
+
+	old_exclusive = cell->arch.cat_exclusive_mask |
+		cell->arch.cat_code_exclusive_mask;
+
+	/*
+	 * Queue bits the cell no longer claims for returning to root, unless
+	 * other cells are still using them. Bits that the cell claims now
+	 * must not be handed out to the root cell.
+	 */
+	freed_mask |= old_exclusive & ~exclusive_mask & orig_root_mask &
+		~others_mask;
+	freed_mask &= ~exclusive_mask;
+
+	/* take new bits away from the root cell before the cell uses them */
+	if ((root_cell.arch.cat_mask & exclusive_mask) != 0 &&
+	    !shrink_root_cell_mask(exclusive_mask)) {
+		freed_mask = old_freed_mask;
+		return trace_error(-EINVAL);
+	}
+
+	cell->arch.cat_mask = data_mask;
+	cell->arch.cat_code_mask = code_mask;
+	cell->arch.cat_exclusive_mask = data_exclusive;
+	cell->arch.cat_code_exclusive_mask = code_exclusive;
+
+	print_cell_masks(cell);
+	cat_update_cell(cell);
+
+	if (merge_freed_mask_to_root()) {
+		printk("CAT: Extended root cell bitmask to %08x\n",
+		       root_cell.arch.cat_mask);
+		cat_update_cell(&root_cell);
+	}
 
 	return 0;
 }
 
 void cat_cell_exit(struct cell *cell)
 {
+	/*
+	 * The CPUs of the cell already belong to the root cell again, let
+	 * them switch to its COS and RMID.
+	 */
+	if (cos_max >= 0 || cell->arch.rmid != 0)
+		cat_update_cell(cell);
+
 	/*
 	 * Only release the mask of cells with an own partition.
 	 * cos is also CAT_ROOT_COS if CAT is unsupported.
@@ -212,7 +646,8 @@ void cat_cell_exit(struct cell *cell)
 	 * Queue bits of released mask for returning to root that were in the
 	 * original root mask as well.
 	 */
-	freed_mask |= cell->arch.cat_mask & orig_root_mask;
+	freed_mask |= (cell->arch.cat_mask | cell->arch.cat_code_mask) &
+		orig_root_mask;
 
 	if (merge_freed_mask_to_root()) {
 		printk("CAT: Extended root cell bitmask to %08x\n",
@@ -220,3 +655,34 @@ void cat_cell_exit(struct cell *cell)
 		cat_update_cell(&root_cell);
 	}
 }
+
+int cat_cell_get_info(struct cell *cell, unsigned long type)
+{
+	long ret;
+
+	if (rmid_max < 0)
+		return -ENODEV;
+
+	switch (type) {
+	case JAILHOUSE_CELL_INFO_L3_OCCUPANCY:
+		ret = cmt_read_counter(cell, CMT_EVENT_L3_OCCUPANCY);
+		if (ret >= 0)
+			ret = ret * cmt_upscale / 1024;
+		break;
+	case JAILHOUSE_CELL_INFO_MEM_TRAFFIC_TOTAL:
+	case JAILHOUSE_CELL_INFO_MEM_TRAFFIC_LOCAL:
+		spin_lock(&cmt_lock);
+		ret = mbm_sample(cell, CMT_EVENT_MBM_TOTAL + type -
+				 JAILHOUSE_CELL_INFO_MEM_TRAFFIC_TOTAL);
+		if (ret == 0)
+			ret = cell->arch.mbm_bytes[type -
+				JAILHOUSE_CELL_INFO_MEM_TRAFFIC_TOTAL] / 1024;
+		spin_unlock(&cmt_lock);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* like CPU statistics, counters wrap around at 31 bits */
+	return ret < 0 ? ret : ret & BIT_MASK(30, 0);
+}
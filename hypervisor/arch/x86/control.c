@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -14,6 +14,7 @@
 #include <jailhouse/pci.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
+#include <jailhouse/string.h>
 #include <asm/apic.h>
 #include <asm/cat.h>
 #include <asm/control.h>
@@ -80,6 +81,10 @@ int arch_map_memory_region(struct cell *cell,
 {
 	int err;
 
+	/* cache coloring is only supported on ARM */
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return trace_error(-EINVAL);
+
 	err = vcpu_map_memory_region(cell, mem);
 	if (err)
 		return err;
@@ -102,6 +107,12 @@ int arch_unmap_memory_region(struct cell *cell,
 	return vcpu_unmap_memory_region(cell, mem);
 }
 
+const struct paging_structures *
+arch_get_cell_paging_structs(struct cell *cell)
+{
+	return vcpu_get_cell_paging_structs(cell);
+}
+
 void arch_flush_cell_vcpu_caches(struct cell *cell)
 {
 	unsigned int cpu;
@@ -111,10 +122,7 @@ void arch_flush_cell_vcpu_caches(struct cell *cell)
 			vcpu_tlb_flush();
 		} else {
 			per_cpu(cpu)->flush_vcpu_caches = true;
-			/* make sure the value is written before we kick
-			 * the remote core */
-			memory_barrier();
-			apic_send_nmi_ipi(per_cpu(cpu));
+			x86_kick_cpu(per_cpu(cpu));
 		}
 }
 
@@ -127,6 +135,48 @@ void arch_cell_destroy(struct cell *cell)
 	vcpu_cell_exit(cell);
 }
 
+int arch_cell_set_mem_bw(struct cell *cell, unsigned long delay)
+{
+	return cat_cell_set_mem_bw(cell, delay);
+}
+
+int arch_cell_get_info(struct cell *cell, unsigned long type)
+{
+	return cat_cell_get_info(cell, type);
+}
+
+int arch_cell_set_cache(struct cell *cell,
+			const struct jailhouse_cache *cache)
+{
+	return cat_cell_set_cache(cell, cache);
+}
+
+int arch_cell_get_dirty_log(struct cell *cell, unsigned long start,
+			    unsigned int num_pages, unsigned long flags,
+			    u8 *bitmap)
+{
+	const struct paging_structures *pg_structs =
+		vcpu_get_cell_paging_structs(cell);
+	unsigned int n;
+	pt_entry_t pte;
+
+	if (!(cell->config->flags & JAILHOUSE_CELL_DIRTY_LOG))
+		return -EINVAL;
+
+	memset(bitmap, 0, (num_pages + 7) / 8);
+	for (n = 0; n < num_pages; n++) {
+		pte = paging_get_terminal_entry(pg_structs,
+						start + n * PAGE_SIZE);
+		if (pte && vcpu_vendor_test_and_clear_dirty(pte, flags))
+			bitmap[n / 8] |= 1 << (n % 8);
+	}
+
+	/* cached translations would not set the cleared flags again */
+	arch_flush_cell_vcpu_caches(cell);
+
+	return 0;
+}
+
 void arch_config_commit(struct cell *cell_added_removed)
 {
 	iommu_config_commit(cell_added_removed);
@@ -190,6 +240,25 @@ void arch_park_cpu(unsigned int cpu_id)
 	arch_resume_cpu(cpu_id);
 }
 
+/**
+ * Kick a CPU so that it processes a pending request. The caller sets the
+ * request flag before. Suspended CPUs check all requests before resuming,
+ * so they are not kicked. This spares them another VM exit right after the
+ * resume, e.g. for all root cell CPUs on cell creation.
+ */
+void x86_kick_cpu(struct per_cpu *target_data)
+{
+	bool target_suspended;
+
+	/* also orders the request before the check and the kick */
+	spin_lock(&target_data->control_lock);
+	target_suspended = target_data->cpu_suspended;
+	spin_unlock(&target_data->control_lock);
+
+	if (!target_suspended)
+		apic_send_nmi_ipi(target_data);
+}
+
 void x86_send_init_sipi(unsigned int cpu_id, enum x86_init_sipi type,
 			int sipi_vector)
 {
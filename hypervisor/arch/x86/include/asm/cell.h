@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -30,12 +30,16 @@ struct arch_cell {
 		struct {
 			/** PIO access bitmap. */
 			u8 *io_bitmap;
+			/** MSR access bitmap. */
+			u8 *msr_bitmap;
 			/** Paging structures used for cell CPUs. */
 			struct paging_structures ept_structs;
 		} vmx; /**< Intel VMX-specific fields. */
 		struct {
 			/** I/O Permissions Map. */
 			u8 *iopm;
+			/** MSR Permissions Map. */
+			u8 *msrpm;
 			/** Paging structures used for cell CPUs and IOMMU. */
 			struct paging_structures npt_iommu_structs;
 		} svm; /**< AMD SVM-specific fields. */
@@ -61,8 +65,28 @@ struct arch_cell {
 
 	/** Class Of Service for cache allocation (Intel only). */
 	u32 cos;
-	/** Allocated L3 cache region (Intel only). */
+	/**
+	 * Allocated L3 cache region (Intel only). This is the data partition
+	 * if code/data prioritization is enabled.
+	 */
 	u64 cat_mask;
+	/** Allocated L3 code partition, equals cat_mask without CDP. */
+	u64 cat_code_mask;
+	/** Part of cat_mask not shared with the root cell. */
+	u64 cat_exclusive_mask;
+	/** Part of cat_code_mask not shared with the root cell. */
+	u64 cat_code_exclusive_mask;
+	/** Memory bandwidth throttling delay of the COS (Intel only). */
+	u32 mba_delay;
+	/**
+	 * Resource monitoring ID (Intel only). 0 for non-root cells means
+	 * that the cell is not monitored.
+	 */
+	u32 rmid;
+	/** Last raw values of the total and local bandwidth counters. */
+	u64 mbm_last[2];
+	/** Accumulated total and local memory traffic in bytes. */
+	u64 mbm_bytes[2];
 };
 
 #endif /* !_JAILHOUSE_ASM_CELL_H */
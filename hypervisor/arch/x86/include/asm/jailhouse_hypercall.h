@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013-2015
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -65,7 +65,11 @@
 #define JAILHOUSE_CPU_STAT_VMEXITS_CPUID	JAILHOUSE_GENERIC_CPU_STATS + 4
 #define JAILHOUSE_CPU_STAT_VMEXITS_XSETBV	JAILHOUSE_GENERIC_CPU_STATS + 5
 #define JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION	JAILHOUSE_GENERIC_CPU_STATS + 6
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 7
+#define JAILHOUSE_CPU_STAT_IVSHMEM_DOORBELLS	JAILHOUSE_GENERIC_CPU_STATS + 7
+#define JAILHOUSE_CPU_STAT_IVSHMEM_IRQS		JAILHOUSE_GENERIC_CPU_STATS + 8
+#define JAILHOUSE_CPU_STAT_IVSHMEM_COALESCED	JAILHOUSE_GENERIC_CPU_STATS + 9
+#define JAILHOUSE_CPU_STAT_VMCS_CACHE_HITS	JAILHOUSE_GENERIC_CPU_STATS + 10
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 11
 
 /* CPUID interface */
 #define JAILHOUSE_CPUID_SIGNATURE		0x40000000
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013, 2014
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -27,6 +27,8 @@
 #define PAGE_FLAG_RW		0x02
 #define PAGE_FLAG_US		0x04
 #define PAGE_FLAG_DEVICE	0x10	/* uncached */
+#define PAGE_FLAG_ACCESSED	0x20
+#define PAGE_FLAG_DIRTY		0x40
 #define PAGE_FLAG_NOEXECUTE	0x8000000000000000UL
 
 #define PAGE_DEFAULT_FLAGS	(PAGE_FLAG_PRESENT | PAGE_FLAG_RW)
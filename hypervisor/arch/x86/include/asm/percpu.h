@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -86,6 +86,16 @@ struct per_cpu {
 	struct segment linux_gs;
 	struct segment linux_tss;
 	unsigned long linux_efer;
+	/** Linux value of MSR_PKG_CST_CONFIG_CONTROL (Intel only). */
+	u64 linux_pkg_cst_config;
+	/** True if linux_pkg_cst_config holds a saved value. */
+	bool pkg_cst_config_saved;
+	/** Linux values of MSR_IA32_L3_QOS_CFG and the COS0 mask MSRs (Intel
+	 *  only). */
+	u64 linux_l3_qos_cfg;
+	u64 linux_l3_mask[2];
+	/** True if the L3 QoS values above were saved. */
+	bool l3_qos_saved;
 	/** @} */
 
 	/** Shadow states. @{ */
@@ -144,6 +154,9 @@ struct per_cpu {
 	/** Number of iterations to clear pending APIC IRQs. */
 	unsigned int num_clear_apic_irqs;
 
+	/** VMCS fields cached during VM exit handling (Intel only). */
+	struct vmcs_cache vmcs_cache;
+
 	union {
 		struct {
 			/** VMXON region, required by VMX. */
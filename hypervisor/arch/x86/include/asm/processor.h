@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -24,11 +24,13 @@
 
 /* leaf 0x01, ECX */
 #define X86_FEATURE_VMX					(1 << 5)
+#define X86_FEATURE_TSC_DEADLINE			(1 << 24)
 #define X86_FEATURE_XSAVE				(1 << 26)
 #define X86_FEATURE_HYPERVISOR				(1 << 31)
 
 /* leaf 0x07, subleaf 0, EBX */
 #define X86_FEATURE_INVPCID				(1 << 10)
+#define X86_FEATURE_CMT					(1 << 12)
 #define X86_FEATURE_CAT					(1 << 15)
 
 /* leaf 0x80000001, ECX */
@@ -44,6 +46,7 @@
 #define X86_FEATURE_DECODE_ASSISTS			(1 << 7)
 #define X86_FEATURE_AVIC				(1 << 13)
 
+#define X86_RFLAGS_IF					(1 << 9)
 #define X86_RFLAGS_VM					(1 << 17)
 
 #define X86_CR0_PE					(1UL << 0)
@@ -68,6 +71,7 @@
 
 #define MSR_IA32_APICBASE				0x0000001b
 #define MSR_IA32_FEATURE_CONTROL			0x0000003a
+#define MSR_PKG_CST_CONFIG_CONTROL			0x000000e2
 #define MSR_IA32_PAT					0x00000277
 #define MSR_IA32_MTRR_DEF_TYPE				0x000002ff
 #define MSR_IA32_SYSENTER_CS				0x00000174
@@ -87,11 +91,16 @@
 #define MSR_IA32_VMX_PROCBASED_CTLS2			0x0000048b
 #define MSR_IA32_VMX_EPT_VPID_CAP			0x0000048c
 #define MSR_IA32_VMX_TRUE_PROCBASED_CTLS		0x0000048e
+#define MSR_IA32_TSC_DEADLINE				0x000006e0
 #define MSR_X2APIC_BASE					0x00000800
 #define MSR_X2APIC_ICR					0x00000830
 #define MSR_X2APIC_END					0x0000083f
+#define MSR_IA32_L3_QOS_CFG				0x00000c81
+#define MSR_IA32_QM_EVTSEL				0x00000c8d
+#define MSR_IA32_QM_CTR					0x00000c8e
 #define MSR_IA32_PQR_ASSOC				0x00000c8f
 #define MSR_IA32_L3_MASK_0				0x00000c90
+#define MSR_IA32_MBA_THRTL_0				0x00000d50
 #define MSR_EFER					0xc0000080
 #define MSR_STAR					0xc0000081
 #define MSR_LSTAR					0xc0000082
@@ -104,6 +113,9 @@
 #define FEATURE_CONTROL_LOCKED				(1 << 0)
 #define FEATURE_CONTROL_VMXON_ENABLED_OUTSIDE_SMX	(1 << 2)
 
+#define PKG_CST_LIMIT_MASK				0x0000000f
+#define PKG_CST_CFG_LOCK				(1 << 15)
+
 #define PAT_RESET_VALUE					0x0007040600070406UL
 
 #define MTRR_ENABLE					(1UL << 11)
@@ -115,9 +127,30 @@
 #define PQR_ASSOC_COS_SHIFT				32
 
 #define CAT_RESID_L3					1
+#define CAT_RESID_MBA					3
 
 #define CAT_CBM_LEN_MASK				BIT_MASK(4, 0)
 #define CAT_COS_MAX_MASK				BIT_MASK(15, 0)
+#define CAT_CDP_SUPPORTED				(1 << 2)
+
+#define L3_QOS_CFG_CDP_ENABLE				(1 << 0)
+
+#define MBA_MAX_DELAY_MASK				BIT_MASK(11, 0)
+#define MBA_LINEAR					(1 << 2)
+
+#define CMT_RESID_L3					1
+
+#define CMT_EVENT_L3_OCCUPANCY				1
+#define CMT_EVENT_MBM_TOTAL				2
+#define CMT_EVENT_MBM_LOCAL				3
+
+#define CMT_MBM_WIDTH_BASE				24
+#define CMT_MBM_WIDTH_OFFSET_MASK			BIT_MASK(7, 0)
+
+#define QM_EVTSEL_RMID_SHIFT				32
+#define QM_CTR_ERROR					(1UL << 63)
+#define QM_CTR_UNAVAILABLE				(1UL << 62)
+#define QM_CTR_DATA_MASK				BIT_MASK(61, 0)
 
 #define GDT_DESC_NULL					0
 #define GDT_DESC_CODE					1
@@ -132,6 +165,9 @@
 #define X86_INST_LEN_HYPERCALL				3
 #define X86_INST_LEN_MOV_TO_CR				3
 #define X86_INST_LEN_XSETBV				3
+#define X86_INST_LEN_HLT				1
+#define X86_INST_LEN_MONITOR				3
+#define X86_INST_LEN_MWAIT				3
 
 #define X86_REX_CODE					4
 
@@ -291,6 +327,14 @@ static inline unsigned long read_msr(unsigned int msr)
 	return low | ((unsigned long)high << 32);
 }
 
+static inline unsigned long read_tsc(void)
+{
+	u32 low, high;
+
+	asm volatile("rdtsc" : "=a" (low), "=d" (high));
+	return low | ((unsigned long)high << 32);
+}
+
 static inline void write_msr(unsigned int msr, unsigned long val)
 {
 	asm volatile("wrmsr"
@@ -25,6 +25,10 @@
 	 X86_CR0_MP | X86_CR0_PE)
 #define X86_CR4_HOST_STATE	X86_CR4_PAE
 
+/* segment selectors with JAILHOUSE_CELL_LONG_MODE_BOOT */
+#define LONG_MODE_BOOT_CS	0x10
+#define LONG_MODE_BOOT_DS	0x18
+
 struct vcpu_io_bitmap {
 	u8 *data;
 	u32 size;
@@ -59,6 +63,8 @@ int vcpu_map_memory_region(struct cell *cell,
 			   const struct jailhouse_memory *mem);
 int vcpu_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem);
+const struct paging_structures *
+vcpu_get_cell_paging_structs(struct cell *cell);
 void vcpu_cell_exit(struct cell *cell);
 void vcpu_vendor_cell_exit(struct cell *cell);
 
@@ -93,9 +99,18 @@ const u8 *vcpu_get_inst_bytes(const struct guest_paging_structures *pg_structs,
 
 void vcpu_skip_emulated_instruction(unsigned int inst_len);
 
+/* loads the 64-bit boot state of the config after vcpu_vendor_reset() */
+void vcpu_vendor_set_long_mode_boot(const struct jailhouse_cell_desc *config);
+
 void vcpu_vendor_get_cell_io_bitmap(struct cell *cell,
 		                    struct vcpu_io_bitmap *out);
 
+/* clears intercepts of the MSR unless they are required by the hypervisor */
+int vcpu_vendor_msr_passthrough(struct cell *cell, u32 msr, u32 flags);
+
+/* returns and resets the dirty or accessed state of a terminal entry */
+bool vcpu_vendor_test_and_clear_dirty(pt_entry_t pte, unsigned long flags);
+
 void vcpu_vendor_get_execution_state(struct vcpu_execution_state *x_state);
 void vcpu_vendor_get_io_intercept(struct vcpu_io_intercept *io);
 void vcpu_vendor_get_mmio_intercept(struct vcpu_mmio_intercept *mmio);
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -201,6 +201,30 @@ struct vmcs {
 
 enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 
+/* VMCS fields that are cached while handling a VM exit */
+enum vmcs_cache_index {
+	VMCS_CACHE_GUEST_RIP,
+	VMCS_CACHE_GUEST_RSP,
+	VMCS_CACHE_GUEST_RFLAGS,
+	VMCS_CACHE_GUEST_CR0,
+	VMCS_CACHE_GUEST_CR3,
+	VMCS_CACHE_GUEST_CR4,
+	VMCS_CACHE_GUEST_IA32_EFER,
+	VMCS_CACHE_GUEST_CS_SELECTOR,
+	VMCS_CACHE_VM_ENTRY_CONTROLS,
+	VMCS_CACHE_EXIT_QUALIFICATION,
+	VMCS_CACHE_GUEST_PHYSICAL_ADDRESS,
+	NUM_VMCS_CACHED_FIELDS
+};
+
+struct vmcs_cache {
+	unsigned long value[NUM_VMCS_CACHED_FIELDS];
+	/* bitmaps of cached fields and of those still to be written back */
+	u16 valid;
+	u16 dirty;
+	bool active;
+};
+
 #define GUEST_SEG_LIMIT			(GUEST_ES_LIMIT - GUEST_ES_SELECTOR)
 #define GUEST_SEG_AR_BYTES		(GUEST_ES_AR_BYTES - GUEST_ES_SELECTOR)
 #define GUEST_SEG_BASE			(GUEST_ES_BASE - GUEST_ES_SELECTOR)
@@ -216,15 +240,19 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define PIN_BASED_NMI_EXITING			(1UL << 3)
 #define PIN_BASED_VMX_PREEMPTION_TIMER		(1UL << 6)
 
+#define CPU_BASED_HLT_EXITING			(1UL << 7)
+#define CPU_BASED_MWAIT_EXITING			(1UL << 10)
 #define CPU_BASED_CR3_LOAD_EXITING		(1UL << 15)
 #define CPU_BASED_CR3_STORE_EXITING		(1UL << 16)
 #define CPU_BASED_USE_IO_BITMAPS		(1UL << 25)
 #define CPU_BASED_USE_MSR_BITMAPS		(1UL << 28)
+#define CPU_BASED_MONITOR_EXITING		(1UL << 29)
 #define CPU_BASED_ACTIVATE_SECONDARY_CONTROLS	(1UL << 31)
 
 #define SECONDARY_EXEC_VIRTUALIZE_APIC_ACCESSES	(1UL << 0)
 #define SECONDARY_EXEC_ENABLE_EPT		(1UL << 1)
 #define SECONDARY_EXEC_RDTSCP			(1UL << 3)
+#define SECONDARY_EXEC_ENABLE_VPID		(1UL << 5)
 #define SECONDARY_EXEC_UNRESTRICTED_GUEST	(1UL << 7)
 #define SECONDARY_EXEC_INVPCID			(1UL << 12)
 
@@ -301,16 +329,20 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define EPT_FLAG_WRITE				0x002
 #define EPT_FLAG_EXECUTE			0x004
 #define EPT_FLAG_WB_TYPE			0x030
+#define EPT_FLAG_ACCESSED			0x100
+#define EPT_FLAG_DIRTY				0x200
 
 #define EPT_TYPE_UNCACHEABLE			0
 #define EPT_TYPE_WRITEBACK			6
 #define EPT_PAGE_WALK_LEN			((4-1) << 3)
+#define EPT_ENABLE_AD_FLAGS			(1UL << 6)
 
 #define EPT_PAGE_WALK_4				(1UL << 6)
 #define EPTP_WB					(1UL << 14)
 #define EPT_2M_PAGES				(1UL << 16)
 #define EPT_1G_PAGES				(1UL << 17)
 #define EPT_INVEPT				(1UL << 20)
+#define EPT_AD_FLAGS				(1UL << 21)
 #define EPT_INVEPT_SINGLE			(1UL << 25)
 #define EPT_INVEPT_GLOBAL			(1UL << 26)
 #define EPT_MANDATORY_FEATURES			(EPT_PAGE_WALK_4 | EPTP_WB | \
@@ -319,6 +351,13 @@ enum vmx_state { VMXOFF = 0, VMXON, VMCS_READY };
 #define VMX_INVEPT_SINGLE			1
 #define VMX_INVEPT_GLOBAL			2
 
+#define VPID_INVVPID				(1UL << 32)
+#define VPID_INVVPID_SINGLE			(1UL << 41)
+#define VPID_INVVPID_GLOBAL			(1UL << 42)
+
+#define VMX_INVVPID_SINGLE			1
+#define VMX_INVVPID_GLOBAL			2
+
 #define APIC_ACCESS_OFFSET_MASK			0x00000fff
 #define APIC_ACCESS_TYPE_MASK			0x0000f000
 #define APIC_ACCESS_TYPE_LINEAR_READ		0x00000000
@@ -197,6 +197,8 @@ int arch_cpu_init(struct per_cpu *cpu_data)
 
 	cpu_data->linux_efer = read_msr(MSR_EFER);
 
+	cat_cpu_init(cpu_data);
+
 	cpu_data->initialized = true;
 
 	err = apic_cpu_init(cpu_data);
@@ -251,6 +253,8 @@ void arch_cpu_restore(struct per_cpu *cpu_data, int return_code)
 
 	vcpu_exit(cpu_data);
 
+	cat_cpu_restore(cpu_data);
+
 	write_msr(MSR_IA32_PAT, cpu_data->pat);
 	write_msr(MSR_EFER, cpu_data->linux_efer);
 	write_cr0(cpu_data->linux_cr0);
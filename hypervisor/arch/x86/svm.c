@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -42,6 +42,7 @@
 
 /* IOPM size: two 4-K pages + 3 bits */
 #define IOPM_PAGES			3
+#define MSRPM_PAGES			2
 
 #define NPT_IOMMU_PAGE_DIR_LEVELS	4
 
@@ -50,10 +51,15 @@ static bool has_avic, has_assists, has_flush_by_asid;
 static const struct segment invalid_seg;
 
 static struct paging npt_iommu_paging[NPT_IOMMU_PAGE_DIR_LEVELS];
+/* dirty logging works on page granularity, thus without huge pages */
+static struct paging npt_iommu_dirty_log_paging[NPT_IOMMU_PAGE_DIR_LEVELS];
 
-/* bit cleared: direct access allowed */
-// TODO: convert to whitelist
-static u8 __attribute__((aligned(PAGE_SIZE))) msrpm[][0x2000/4] = {
+/*
+ * Default MSR intercepts, copied into the permission map of cells without MSR
+ * whitelist. MSRs set here are always intercepted.
+ * bit cleared: direct access allowed
+ */
+static u8 msrpm[][0x2000/4] = {
 	[ SVM_MSRPM_0000 ] = {
 		[      0/4 ...  0x017/4 ] = 0,
 		[  0x018/4 ...  0x01b/4 ] = 0x80, /* 0x01b (w) */
@@ -153,8 +159,19 @@ static void set_svm_segment_from_segment(struct svm_segment *svm_segment,
 static void svm_set_cell_config(struct cell *cell, struct vmcb *vmcb)
 {
 	vmcb->iopm_base_pa = paging_hvirt2phys(cell->arch.svm.iopm);
+	vmcb->msrpm_base_pa = paging_hvirt2phys(cell->arch.svm.msrpm);
 	vmcb->n_cr3 =
 		paging_hvirt2phys(cell->arch.svm.npt_iommu_structs.root_table);
+
+	if (cell->config->flags & JAILHOUSE_CELL_IDLE_POLL) {
+		vmcb->general1_intercepts |= GENERAL1_INTERCEPT_HLT;
+		vmcb->general2_intercepts |= GENERAL2_INTERCEPT_MONITOR |
+			GENERAL2_INTERCEPT_MWAIT;
+	} else {
+		vmcb->general1_intercepts &= ~GENERAL1_INTERCEPT_HLT;
+		vmcb->general2_intercepts &= ~(GENERAL2_INTERCEPT_MONITOR |
+					       GENERAL2_INTERCEPT_MWAIT);
+	}
 }
 
 static void vmcb_setup(struct per_cpu *cpu_data)
@@ -222,11 +239,14 @@ static void vmcb_setup(struct per_cpu *cpu_data)
 	 */
 	vmcb->exception_intercepts |= (1 << DB_VECTOR) | (1 << AC_VECTOR);
 
-	vmcb->msrpm_base_pa = paging_hvirt2phys(msrpm);
-
 	vmcb->np_enable = 1;
-	/* No more than one guest owns the CPU */
+	/*
+	 * No more than one guest owns the CPU, so a single ASID per CPU
+	 * suffices. Its entries are flushed whenever the CPU changes cells.
+	 */
 	vmcb->guest_asid = 1;
+	/* the ASID may still be tagging entries of an earlier activation */
+	vcpu_tlb_flush();
 
 	/* TODO: Setup AVIC */
 
@@ -310,6 +330,11 @@ int vcpu_vendor_init(void)
 	npt_iommu_paging[1].get_phys = npt_iommu_get_phys_l3;
 	npt_iommu_paging[2].get_phys = npt_iommu_get_phys_l2;
 
+	memcpy(npt_iommu_dirty_log_paging, npt_iommu_paging,
+	       sizeof(npt_iommu_paging));
+	npt_iommu_dirty_log_paging[1].page_size = 0;
+	npt_iommu_dirty_log_paging[2].page_size = 0;
+
 	/* Map guest parking code (shared between cells and CPUs) */
 	parking_pt.root_paging = npt_iommu_paging;
 	parking_pt.root_table = parked_mode_npt = page_alloc(&mem_pool, 1);
@@ -345,13 +370,29 @@ int vcpu_vendor_cell_init(struct cell *cell)
 	int err = -ENOMEM;
 	u64 flags;
 
+	/* C-state limits are only supported on Intel */
+	if (cell->config->flags & JAILHOUSE_CELL_CSTATE_LIMIT)
+		return trace_error(-EINVAL);
+
 	/* allocate iopm  */
 	cell->arch.svm.iopm = page_alloc(&mem_pool, IOPM_PAGES);
 	if (!cell->arch.svm.iopm)
 		return err;
 
+	/* allocate msrpm, trap everything if the cell whitelists MSRs */
+	cell->arch.svm.msrpm = page_alloc(&mem_pool, MSRPM_PAGES);
+	if (!cell->arch.svm.msrpm)
+		goto err_free_iopm;
+	if (cell->config->num_msr_ranges > 0)
+		memset(cell->arch.svm.msrpm, -1, sizeof(msrpm));
+	else
+		memcpy(cell->arch.svm.msrpm, msrpm, sizeof(msrpm));
+
 	/* build root NPT of cell */
-	cell->arch.svm.npt_iommu_structs.root_paging = npt_iommu_paging;
+	/* nested paging always maintains the accessed and dirty flags */
+	cell->arch.svm.npt_iommu_structs.root_paging =
+		cell->config->flags & JAILHOUSE_CELL_DIRTY_LOG ?
+		npt_iommu_dirty_log_paging : npt_iommu_paging;
 	cell->arch.svm.npt_iommu_structs.root_table =
 		(page_table_t)cell->arch.root_table_page;
 
@@ -371,10 +412,12 @@ int vcpu_vendor_cell_init(struct cell *cell)
 				    flags, PAGING_NON_COHERENT);
 	}
 	if (err)
-		goto err_free_iopm;
+		goto err_free_msrpm;
 
 	return 0;
 
+err_free_msrpm:
+	page_free(&mem_pool, cell->arch.svm.msrpm, MSRPM_PAGES);
 err_free_iopm:
 	page_free(&mem_pool, cell->arch.svm.iopm, 3);
 
@@ -414,13 +457,45 @@ int vcpu_unmap_memory_region(struct cell *cell,
 			      mem->virt_start, mem->size, PAGING_COHERENT);
 }
 
+const struct paging_structures *
+vcpu_get_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.svm.npt_iommu_structs;
+}
+
 void vcpu_vendor_cell_exit(struct cell *cell)
 {
 	paging_destroy(&cell->arch.svm.npt_iommu_structs, XAPIC_BASE,
 		       PAGE_SIZE, PAGING_NON_COHERENT);
+	page_free(&mem_pool, cell->arch.svm.msrpm, MSRPM_PAGES);
 	page_free(&mem_pool, cell->arch.svm.iopm, 3);
 }
 
+int vcpu_vendor_msr_passthrough(struct cell *cell, u32 msr, u32 flags)
+{
+	u8 (*map)[0x2000/4] = (void *)cell->arch.svm.msrpm;
+	unsigned int idx = msr & 0x1fff, vector;
+	u8 mask = 0;
+
+	if (msr <= 0x1fff)
+		vector = SVM_MSRPM_0000;
+	else if (msr >= 0xc0000000 && msr <= 0xc0001fff)
+		vector = SVM_MSRPM_C000;
+	else if (msr >= 0xc0010000 && msr <= 0xc0011fff)
+		vector = SVM_MSRPM_C001;
+	else
+		return trace_error(-EINVAL);
+
+	/* two bits per MSR: read, write */
+	if (flags & JAILHOUSE_MSR_READ)
+		mask |= 1 << ((idx % 4) * 2);
+	if (flags & JAILHOUSE_MSR_WRITE)
+		mask |= 2 << ((idx % 4) * 2);
+	map[vector][idx / 4] &= ~(mask & ~msrpm[vector][idx / 4]);
+
+	return 0;
+}
+
 int vcpu_init(struct per_cpu *cpu_data)
 {
 	unsigned long efer;
@@ -640,6 +715,8 @@ void vcpu_vendor_reset(unsigned int sipi_vector)
 	vmcb->clean_bits = 0;
 
 	svm_set_cell_config(cpu_data->cell, vmcb);
+	/* the CPU may have switched cells, drop the old guest's entries */
+	vcpu_tlb_flush();
 
 	asm volatile(
 		"vmload %%rax"
@@ -648,6 +725,38 @@ void vcpu_vendor_reset(unsigned int sipi_vector)
 	write_msr(MSR_GS_BASE, (unsigned long)cpu_data);
 }
 
+void vcpu_vendor_set_long_mode_boot(const struct jailhouse_cell_desc *config)
+{
+	static const struct svm_segment dataseg_long_mode_state = {
+		.selector = LONG_MODE_BOOT_DS,
+		.base = 0,
+		.limit = 0xffffffff,
+		.access_rights = 0x0c93,
+	};
+	struct vmcb *vmcb = &this_cpu_data()->vmcb;
+
+	vmcb->cr0 = X86_CR0_PG | X86_CR0_WP | X86_CR0_ET | X86_CR0_PE;
+	vmcb->cr3 = config->boot_page_table;
+	vmcb->cr4 = X86_CR4_PAE;
+	vmcb->efer = EFER_SVME | EFER_LMA | EFER_LME;
+
+	vmcb->rip = config->boot_entry;
+
+	vmcb->cs.selector = LONG_MODE_BOOT_CS;
+	vmcb->cs.base = 0;
+	vmcb->cs.limit = 0xffffffff;
+	vmcb->cs.access_rights = 0x0a9b;
+
+	vmcb->ds = dataseg_long_mode_state;
+	vmcb->es = dataseg_long_mode_state;
+	vmcb->ss = dataseg_long_mode_state;
+
+	vmcb->gdtr.base = config->boot_gdt;
+	vmcb->gdtr.limit = config->boot_gdt_limit;
+
+	vmcb->clean_bits &= ~(CLEAN_BITS_CRX | CLEAN_BITS_DT | CLEAN_BITS_SEG);
+}
+
 void vcpu_skip_emulated_instruction(unsigned int inst_len)
 {
 	this_cpu_data()->vmcb.rip += inst_len;
@@ -811,6 +920,22 @@ static bool svm_handle_cr(struct per_cpu *cpu_data)
 	return true;
 }
 
+static void svm_handle_hlt(struct vmcb *vmcb)
+{
+	/*
+	 * Only a halt with interrupts disabled is meant to be final. Drop the
+	 * intercept then and let the guest execute HLT again, stopping the CPU
+	 * for real. The next reset restores the intercept. Otherwise, return
+	 * to the guest so that it polls.
+	 */
+	if (!(vmcb->rflags & X86_RFLAGS_IF)) {
+		vmcb->general1_intercepts &= ~GENERAL1_INTERCEPT_HLT;
+		vmcb->clean_bits &= ~CLEAN_BITS_I;
+	} else {
+		vcpu_skip_emulated_instruction(X86_INST_LEN_HLT);
+	}
+}
+
 static bool svm_handle_msr_write(struct per_cpu *cpu_data)
 {
 	struct vmcb *vmcb = &cpu_data->vmcb;
@@ -918,6 +1043,8 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 	 * the bits as needed.
 	 */
 	vmcb->clean_bits = 0xffffffff;
+	/* A requested flush was performed by the last VMRUN. */
+	vmcb->tlb_control = SVM_TLB_FLUSH_NONE;
 
 	switch (vmcb->exitcode) {
 	case VMEXIT_INVALID:
@@ -941,6 +1068,16 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 	case VMEXIT_CPUID:
 		vcpu_handle_cpuid();
 		goto vmentry;
+	case VMEXIT_HLT:
+		svm_handle_hlt(vmcb);
+		goto vmentry;
+	case VMEXIT_MWAIT:
+		/* MWAIT may return spuriously, so treat it as NOP */
+		vcpu_skip_emulated_instruction(X86_INST_LEN_MWAIT);
+		goto vmentry;
+	case VMEXIT_MONITOR:
+		vcpu_skip_emulated_instruction(X86_INST_LEN_MONITOR);
+		goto vmentry;
 	case VMEXIT_MSR:
 		cpu_data->stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR]++;
 		if (!vmcb->exitinfo1)
@@ -1013,6 +1150,18 @@ void vcpu_nmi_handler(void)
 {
 }
 
+bool vcpu_vendor_test_and_clear_dirty(pt_entry_t pte, unsigned long flags)
+{
+	unsigned long mask = flags & JAILHOUSE_DIRTY_LOG_ACCESSED ?
+		PAGE_FLAG_ACCESSED : PAGE_FLAG_DIRTY;
+
+	/* the cell is suspended, so no CPU updates the entry concurrently */
+	if (!(*pte & mask))
+		return false;
+	*pte &= ~mask;
+	return true;
+}
+
 void vcpu_tlb_flush(void)
 {
 	struct vmcb *vmcb = &this_cpu_data()->vmcb;
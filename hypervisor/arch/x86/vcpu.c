@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  * Copyright (c) Valentine Sinitsyn, 2014
  *
  * Authors:
@@ -55,6 +55,72 @@ out_err:
 	return NULL;
 }
 
+static int vcpu_cell_init_msr_bitmap(struct cell *cell)
+{
+	const struct jailhouse_msr_range *range =
+		jailhouse_cell_msr_ranges(cell->config);
+	unsigned int n;
+	u32 msr;
+	int err;
+
+	/* without whitelist, the vendor code applied the default intercepts */
+	if (cell->config->num_msr_ranges == 0)
+		return 0;
+
+	/*
+	 * The whitelist does not affect the x2APIC MSRs. Like cells without a
+	 * whitelist, the cell gets direct access to them, except for ICR
+	 * writes, which stay intercepted. If the host does not use x2APIC,
+	 * all of them stay intercepted.
+	 */
+	if (using_x2apic)
+		for (msr = MSR_X2APIC_BASE; msr <= MSR_X2APIC_END; msr++)
+			vcpu_vendor_msr_passthrough(cell, msr,
+						    JAILHOUSE_MSR_READ |
+						    JAILHOUSE_MSR_WRITE);
+
+	for (n = 0; n < cell->config->num_msr_ranges; n++, range++) {
+		if (range->size == 0 || range->start + range->size - 1 <
+		    range->start || range->flags & ~(JAILHOUSE_MSR_READ |
+						     JAILHOUSE_MSR_WRITE))
+			return trace_error(-EINVAL);
+
+		for (msr = range->start; msr - range->start < range->size;
+		     msr++) {
+			err = vcpu_vendor_msr_passthrough(cell, msr,
+							  range->flags);
+			if (err)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+static bool vcpu_canonical_addr(u64 addr)
+{
+	return (s64)(addr << 16) >> 16 == (s64)addr;
+}
+
+static int vcpu_check_long_mode_boot(const struct jailhouse_cell_desc *config)
+{
+	unsigned int phys_bits = cpuid_eax(0x80000008, 0) & 0xff;
+
+	if (!(config->flags & JAILHOUSE_CELL_LONG_MODE_BOOT))
+		return 0;
+
+	/* invalid values would fail the VM entry instead of the guest */
+	if (!vcpu_canonical_addr(config->boot_entry) ||
+	    !vcpu_canonical_addr(config->boot_gdt) ||
+	    config->boot_gdt_limit < LONG_MODE_BOOT_DS + 7 ||
+	    config->boot_gdt_limit > 0xffff ||
+	    config->boot_page_table & ~PAGE_MASK ||
+	    config->boot_page_table >> phys_bits)
+		return trace_error(-EINVAL);
+
+	return 0;
+}
+
 int vcpu_cell_init(struct cell *cell)
 {
 	const u8 *pio_bitmap = jailhouse_cell_pio_bitmap(cell->config);
@@ -69,10 +135,20 @@ int vcpu_cell_init(struct cell *cell)
 	if (system_config->platform_info.x86.pm_timer_address == 0)
 		return trace_error(-EINVAL);
 
+	err = vcpu_check_long_mode_boot(cell->config);
+	if (err)
+		return err;
+
 	err = vcpu_vendor_cell_init(cell);
 	if (err)
 		return err;
 
+	err = vcpu_cell_init_msr_bitmap(cell);
+	if (err) {
+		vcpu_vendor_cell_exit(cell);
+		return err;
+	}
+
 	vcpu_vendor_get_cell_io_bitmap(cell, &cell_iobm);
 
 	/* initialize io bitmap to trap all accesses */
@@ -150,6 +226,18 @@ void vcpu_handle_hypercall(void)
 		return;
 	}
 
+	/*
+	 * Fast path for ivshmem doorbells: the device and the value are passed
+	 * in registers, so there is no need to decode an MMIO access.
+	 */
+	if (code == JAILHOUSE_HC_IVSHMEM_DOORBELL) {
+		this_cpu_data()->stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
+		guest_regs->rax = pci_ivshmem_doorbell(this_cell(),
+						       guest_regs->rdi,
+						       guest_regs->rsi);
+		return;
+	}
+
 	guest_regs->rax = hypercall(code, guest_regs->rdi & arg_mask,
 				    guest_regs->rsi & arg_mask);
 	if (guest_regs->rax == -ENOSYS)
@@ -366,6 +454,7 @@ bool vcpu_handle_xsetbv(void)
 void vcpu_reset(unsigned int sipi_vector)
 {
 	struct per_cpu *cpu_data = this_cpu_data();
+	const struct jailhouse_cell_desc *config = cpu_data->cell->config;
 
 	vcpu_vendor_reset(sipi_vector);
 
@@ -373,7 +462,18 @@ void vcpu_reset(unsigned int sipi_vector)
 
 	if (sipi_vector == APIC_BSP_PSEUDO_SIPI) {
 		cpu_data->pat = PAT_RESET_VALUE;
-		cpu_data->mtrr_def_type = 0;
-		vcpu_vendor_set_guest_pat(0);
+		if (config->flags & JAILHOUSE_CELL_LONG_MODE_BOOT) {
+			/*
+			 * Skip the real-mode reset vector and the mode
+			 * switches of the guest. The boot code would enable
+			 * the MTRRs anyway, so do this here as well.
+			 */
+			vcpu_vendor_set_long_mode_boot(config);
+			cpu_data->mtrr_def_type = MTRR_ENABLE;
+			vcpu_vendor_set_guest_pat(cpu_data->pat);
+		} else {
+			cpu_data->mtrr_def_type = 0;
+			vcpu_vendor_set_guest_pat(0);
+		}
 	}
 }
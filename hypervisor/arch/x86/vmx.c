@@ -29,14 +29,18 @@
 #define CR4_IDX			1
 
 #define PIO_BITMAP_PAGES	2
+#define MSR_BITMAP_PAGES	1
 
 static const struct segment invalid_seg = {
 	.access_rights = 0x10000
 };
 
-/* bit cleared: direct access allowed */
-// TODO: convert to whitelist
-static u8 __attribute__((aligned(PAGE_SIZE))) msr_bitmap[][0x2000/8] = {
+/*
+ * Default MSR intercepts, copied into the bitmap of cells without MSR
+ * whitelist. MSRs set here are always intercepted.
+ * bit cleared: direct access allowed
+ */
+static u8 msr_bitmap[][0x2000/8] = {
 	[ VMX_MSR_BMP_0000_READ ] = {
 		[      0/8 ...  0x26f/8 ] = 0,
 		[  0x270/8 ...  0x277/8 ] = 0x80, /* 0x277 */
@@ -80,7 +84,10 @@ static u8 __attribute__((aligned(PAGE_SIZE))) msr_bitmap[][0x2000/8] = {
 };
 static u8 __attribute__((aligned(PAGE_SIZE))) apic_access_page[PAGE_SIZE];
 static struct paging ept_paging[EPT_PAGE_DIR_LEVELS];
+/* dirty logging works on page granularity, thus without huge pages */
+static struct paging ept_dirty_log_paging[EPT_PAGE_DIR_LEVELS];
 static u32 secondary_exec_addon;
+static unsigned long invvpid_type;
 static unsigned long cr_maybe1[2], cr_required1[2];
 
 static bool vmxon(struct per_cpu *cpu_data)
@@ -126,11 +133,71 @@ static bool vmcs_load(struct per_cpu *cpu_data)
 	return ok;
 }
 
-static inline unsigned long vmcs_read64(unsigned long field)
+static const u32 vmcs_cached_fields[NUM_VMCS_CACHED_FIELDS] = {
+	[VMCS_CACHE_GUEST_RIP]			= GUEST_RIP,
+	[VMCS_CACHE_GUEST_RSP]			= GUEST_RSP,
+	[VMCS_CACHE_GUEST_RFLAGS]		= GUEST_RFLAGS,
+	[VMCS_CACHE_GUEST_CR0]			= GUEST_CR0,
+	[VMCS_CACHE_GUEST_CR3]			= GUEST_CR3,
+	[VMCS_CACHE_GUEST_CR4]			= GUEST_CR4,
+	[VMCS_CACHE_GUEST_IA32_EFER]		= GUEST_IA32_EFER,
+	[VMCS_CACHE_GUEST_CS_SELECTOR]		= GUEST_CS_SELECTOR,
+	[VMCS_CACHE_VM_ENTRY_CONTROLS]		= VM_ENTRY_CONTROLS,
+	[VMCS_CACHE_EXIT_QUALIFICATION]		= EXIT_QUALIFICATION,
+	[VMCS_CACHE_GUEST_PHYSICAL_ADDRESS]	= GUEST_PHYSICAL_ADDRESS,
+};
+
+/* callers pass constant fields, so this is resolved at build time */
+static inline __attribute__((always_inline)) int
+vmcs_cache_index(unsigned long field)
+{
+	switch (field) {
+	case GUEST_RIP:
+		return VMCS_CACHE_GUEST_RIP;
+	case GUEST_RSP:
+		return VMCS_CACHE_GUEST_RSP;
+	case GUEST_RFLAGS:
+		return VMCS_CACHE_GUEST_RFLAGS;
+	case GUEST_CR0:
+		return VMCS_CACHE_GUEST_CR0;
+	case GUEST_CR3:
+		return VMCS_CACHE_GUEST_CR3;
+	case GUEST_CR4:
+		return VMCS_CACHE_GUEST_CR4;
+	case GUEST_IA32_EFER:
+		return VMCS_CACHE_GUEST_IA32_EFER;
+	case GUEST_CS_SELECTOR:
+		return VMCS_CACHE_GUEST_CS_SELECTOR;
+	case VM_ENTRY_CONTROLS:
+		return VMCS_CACHE_VM_ENTRY_CONTROLS;
+	case EXIT_QUALIFICATION:
+		return VMCS_CACHE_EXIT_QUALIFICATION;
+	case GUEST_PHYSICAL_ADDRESS:
+		return VMCS_CACHE_GUEST_PHYSICAL_ADDRESS;
+	default:
+		return -1;
+	}
+}
+
+static inline __attribute__((always_inline)) unsigned long
+vmcs_read64(unsigned long field)
 {
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct vmcs_cache *cache = &cpu_data->vmcs_cache;
+	int idx = vmcs_cache_index(field);
 	unsigned long value;
 
+	if (idx >= 0 && cache->valid & (1 << idx)) {
+		cpu_data->stats[JAILHOUSE_CPU_STAT_VMCS_CACHE_HITS]++;
+		return cache->value[idx];
+	}
+
 	asm volatile("vmread %1,%0" : "=r" (value) : "r" (field) : "cc");
+
+	if (idx >= 0 && cache->active) {
+		cache->value[idx] = value;
+		cache->valid |= 1 << idx;
+	}
 	return value;
 }
 
@@ -146,8 +213,17 @@ static inline u32 vmcs_read32(unsigned long field)
 
 static bool vmcs_write64(unsigned long field, unsigned long val)
 {
+	struct vmcs_cache *cache = &this_cpu_data()->vmcs_cache;
+	int idx = vmcs_cache_index(field);
 	u8 ok;
 
+	/* write through, superseding a pending write-back */
+	if (idx >= 0 && cache->active) {
+		cache->value[idx] = val;
+		cache->valid |= 1 << idx;
+		cache->dirty &= ~(1 << idx);
+	}
+
 	asm volatile(
 		"vmwrite %1,%2\n\t"
 		"setnz %0"
@@ -161,6 +237,41 @@ static bool vmcs_write64(unsigned long field, unsigned long val)
 	return ok;
 }
 
+/*
+ * Defers the VMCS update to the end of the VM exit handling. Repeated updates
+ * are merged, and subsequent reads are served from the cache.
+ */
+static void vmcs_write64_deferred(unsigned long field, unsigned long val)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	struct vmcs_cache *cache = &cpu_data->vmcs_cache;
+	int idx = vmcs_cache_index(field);
+
+	if (idx < 0 || !cache->active) {
+		vmcs_write64(field, val);
+		return;
+	}
+
+	if (cache->dirty & (1 << idx))
+		cpu_data->stats[JAILHOUSE_CPU_STAT_VMCS_CACHE_HITS]++;
+	cache->value[idx] = val;
+	cache->valid |= 1 << idx;
+	cache->dirty |= 1 << idx;
+}
+
+static void vmcs_cache_flush(struct vmcs_cache *cache)
+{
+	unsigned int idx;
+
+	cache->active = false;
+	for (idx = 0; idx < NUM_VMCS_CACHED_FIELDS; idx++)
+		if (cache->dirty & (1 << idx))
+			vmcs_write64(vmcs_cached_fields[idx],
+				     cache->value[idx]);
+	cache->valid = 0;
+	cache->dirty = 0;
+}
+
 static bool vmcs_write16(unsigned long field, u16 value)
 {
 	return vmcs_write64(field, value);
@@ -241,6 +352,20 @@ static int vmx_check_features(void)
 	if ((vmx_proc_ctrl2 & secondary_exec_addon) != secondary_exec_addon)
 		return trace_error(-EIO);
 
+	/*
+	 * Use VPIDs if INVVPID is available. This keeps guest TLB entries
+	 * across VM exits and entries.
+	 */
+	if (vmx_proc_ctrl2 & SECONDARY_EXEC_ENABLE_VPID &&
+	    ept_cap & VPID_INVVPID) {
+		if (ept_cap & VPID_INVVPID_SINGLE)
+			invvpid_type = VMX_INVVPID_SINGLE;
+		else if (ept_cap & VPID_INVVPID_GLOBAL)
+			invvpid_type = VMX_INVVPID_GLOBAL;
+		if (invvpid_type)
+			secondary_exec_addon |= SECONDARY_EXEC_ENABLE_VPID;
+	}
+
 	/* require PAT and EFER save/restore */
 	vmx_entry_ctrl = read_msr(MSR_IA32_VMX_ENTRY_CTLS) >> 32;
 	vmx_exit_ctrl = read_msr(MSR_IA32_VMX_EXIT_CTLS) >> 32;
@@ -306,6 +431,10 @@ int vcpu_vendor_init(void)
 	if (!(read_msr(MSR_IA32_VMX_EPT_VPID_CAP) & EPT_2M_PAGES))
 		ept_paging[2].page_size = 0;
 
+	memcpy(ept_dirty_log_paging, ept_paging, sizeof(ept_paging));
+	ept_dirty_log_paging[1].page_size = 0;
+	ept_dirty_log_paging[2].page_size = 0;
+
 	if (using_x2apic) {
 		/* allow direct x2APIC access except for ICR writes */
 		memset(&msr_bitmap[VMX_MSR_BMP_0000_READ][MSR_X2APIC_BASE/8],
@@ -327,15 +456,57 @@ unsigned long arch_paging_gphys2phys(struct per_cpu *cpu_data,
 
 int vcpu_vendor_cell_init(struct cell *cell)
 {
+	unsigned long idle_exiting = CPU_BASED_HLT_EXITING |
+		CPU_BASED_MWAIT_EXITING | CPU_BASED_MONITOR_EXITING;
 	int err;
 
+	if (cell->config->flags & JAILHOUSE_CELL_IDLE_POLL &&
+	    ((read_msr(MSR_IA32_VMX_PROCBASED_CTLS) >> 32) & idle_exiting) !=
+	    idle_exiting)
+		return trace_error(-EIO);
+
+	/*
+	 * The limit is applied per CPU, and the firmware may have locked it.
+	 * We can only check this on the calling CPU and rely on the firmware
+	 * to lock the MSR consistently.
+	 */
+	if (cell->config->flags & JAILHOUSE_CELL_CSTATE_LIMIT) {
+		if (cell->config->cstate_limit & ~PKG_CST_LIMIT_MASK)
+			return trace_error(-EINVAL);
+		if (read_msr(MSR_PKG_CST_CONFIG_CONTROL) & PKG_CST_CFG_LOCK)
+			return trace_error(-EIO);
+	}
+
+	if (cell->config->flags & JAILHOUSE_CELL_DIRTY_LOG &&
+	    !(read_msr(MSR_IA32_VMX_EPT_VPID_CAP) & EPT_AD_FLAGS))
+		return trace_error(-EIO);
+
 	/* allocate io_bitmap */
 	cell->arch.vmx.io_bitmap = page_alloc(&mem_pool, PIO_BITMAP_PAGES);
 	if (!cell->arch.vmx.io_bitmap)
 		return -ENOMEM;
 
+	/* allocate msr_bitmap, trap everything if the cell whitelists MSRs */
+	cell->arch.vmx.msr_bitmap = page_alloc(&mem_pool, MSR_BITMAP_PAGES);
+	if (!cell->arch.vmx.msr_bitmap) {
+		err = -ENOMEM;
+		goto err_free_io_bitmap;
+	}
+	if (cell->config->num_msr_ranges > 0)
+		memset(cell->arch.vmx.msr_bitmap, -1, sizeof(msr_bitmap));
+	else
+		memcpy(cell->arch.vmx.msr_bitmap, msr_bitmap,
+		       sizeof(msr_bitmap));
+	/* writes are ignored, see also vcpu_vendor_msr_passthrough */
+	if (cell->config->flags & JAILHOUSE_CELL_CSTATE_LIMIT)
+		cell->arch.vmx.msr_bitmap[VMX_MSR_BMP_0000_WRITE * 0x2000/8 +
+			MSR_PKG_CST_CONFIG_CONTROL / 8] |=
+			1 << (MSR_PKG_CST_CONFIG_CONTROL % 8);
+
 	/* build root EPT of cell */
-	cell->arch.vmx.ept_structs.root_paging = ept_paging;
+	cell->arch.vmx.ept_structs.root_paging =
+		cell->config->flags & JAILHOUSE_CELL_DIRTY_LOG ?
+		ept_dirty_log_paging : ept_paging;
 	cell->arch.vmx.ept_structs.root_table =
 		(page_table_t)cell->arch.root_table_page;
 
@@ -345,10 +516,12 @@ int vcpu_vendor_cell_init(struct cell *cell)
 			    EPT_FLAG_READ | EPT_FLAG_WRITE | EPT_FLAG_WB_TYPE,
 			    PAGING_NON_COHERENT);
 	if (err)
-		goto err_free_io_bitmap;
+		goto err_free_msr_bitmap;
 
 	return 0;
 
+err_free_msr_bitmap:
+	page_free(&mem_pool, cell->arch.vmx.msr_bitmap, MSR_BITMAP_PAGES);
 err_free_io_bitmap:
 	page_free(&mem_pool, cell->arch.vmx.io_bitmap, 2);
 
@@ -381,13 +554,63 @@ int vcpu_unmap_memory_region(struct cell *cell,
 			      mem->size, PAGING_NON_COHERENT);
 }
 
+const struct paging_structures *
+vcpu_get_cell_paging_structs(struct cell *cell)
+{
+	return &cell->arch.vmx.ept_structs;
+}
+
 void vcpu_vendor_cell_exit(struct cell *cell)
 {
 	paging_destroy(&cell->arch.vmx.ept_structs, XAPIC_BASE, PAGE_SIZE,
 		       PAGING_NON_COHERENT);
+	page_free(&mem_pool, cell->arch.vmx.msr_bitmap, MSR_BITMAP_PAGES);
 	page_free(&mem_pool, cell->arch.vmx.io_bitmap, 2);
 }
 
+int vcpu_vendor_msr_passthrough(struct cell *cell, u32 msr, u32 flags)
+{
+	u8 (*bitmap)[0x2000/8] = (void *)cell->arch.vmx.msr_bitmap;
+	unsigned int read_bmp, write_bmp, idx = msr & 0x1fff;
+	u8 mask = 1 << (idx % 8);
+
+	if (msr <= 0x1fff) {
+		read_bmp = VMX_MSR_BMP_0000_READ;
+		write_bmp = VMX_MSR_BMP_0000_WRITE;
+	} else if (msr >= 0xc0000000 && msr <= 0xc0001fff) {
+		read_bmp = VMX_MSR_BMP_C000_READ;
+		write_bmp = VMX_MSR_BMP_C000_WRITE;
+	} else {
+		return trace_error(-EINVAL);
+	}
+
+	/* the cell must not lift its own C-state limit */
+	if (msr == MSR_PKG_CST_CONFIG_CONTROL &&
+	    cell->config->flags & JAILHOUSE_CELL_CSTATE_LIMIT)
+		flags &= ~JAILHOUSE_MSR_WRITE;
+
+	if (flags & JAILHOUSE_MSR_READ &&
+	    !(msr_bitmap[read_bmp][idx / 8] & mask))
+		bitmap[read_bmp][idx / 8] &= ~mask;
+	if (flags & JAILHOUSE_MSR_WRITE &&
+	    !(msr_bitmap[write_bmp][idx / 8] & mask))
+		bitmap[write_bmp][idx / 8] &= ~mask;
+
+	return 0;
+}
+
+bool vcpu_vendor_test_and_clear_dirty(pt_entry_t pte, unsigned long flags)
+{
+	unsigned long mask = flags & JAILHOUSE_DIRTY_LOG_ACCESSED ?
+		EPT_FLAG_ACCESSED : EPT_FLAG_DIRTY;
+
+	/* the cell is suspended, so no CPU updates the entry concurrently */
+	if (!(*pte & mask))
+		return false;
+	*pte &= ~mask;
+	return true;
+}
+
 void vcpu_tlb_flush(void)
 {
 	unsigned long ept_cap = read_msr(MSR_IA32_VMX_EPT_VPID_CAP);
@@ -420,6 +643,38 @@ void vcpu_tlb_flush(void)
 	}
 }
 
+/*
+ * Invalidate the TLB entries of the guest running on this CPU. Only required
+ * when the guest state is changed behind its back, i.e. on resets and for
+ * emulated CR writes, as VM entries do not flush with VPIDs.
+ */
+static void vmx_vpid_flush(void)
+{
+	struct {
+		u64 vpid;
+		u64 address;
+	} descriptor;
+	u8 ok;
+
+	if (!invvpid_type)
+		return;
+
+	descriptor.vpid = vmcs_read16(VIRTUAL_PROCESSOR_ID);
+	descriptor.address = 0;
+	asm volatile(
+		"invvpid (%1),%2\n\t"
+		"seta %0\n\t"
+		: "=qm" (ok)
+		: "r" (&descriptor), "r" (invvpid_type)
+		: "memory", "cc");
+
+	if (!ok) {
+		panic_printk("FATAL: invvpid failed, error %d\n",
+			     vmcs_read32(VM_INSTRUCTION_ERROR));
+		panic_stop();
+	}
+}
+
 static bool vmx_set_guest_cr(unsigned int cr_idx, unsigned long val)
 {
 	bool ok = true;
@@ -436,9 +691,31 @@ static bool vmx_set_guest_cr(unsigned int cr_idx, unsigned long val)
 	return ok;
 }
 
+static void vmx_set_cstate_limit(struct per_cpu *cpu_data,
+				 struct cell *cell)
+{
+	unsigned long val;
+
+	if (cell->config->flags & JAILHOUSE_CELL_CSTATE_LIMIT) {
+		if (!cpu_data->pkg_cst_config_saved) {
+			cpu_data->linux_pkg_cst_config =
+				read_msr(MSR_PKG_CST_CONFIG_CONTROL);
+			cpu_data->pkg_cst_config_saved = true;
+		}
+		val = (cpu_data->linux_pkg_cst_config & ~PKG_CST_LIMIT_MASK) |
+			cell->config->cstate_limit;
+	} else if (cpu_data->pkg_cst_config_saved) {
+		val = cpu_data->linux_pkg_cst_config;
+	} else {
+		return;
+	}
+	write_msr(MSR_PKG_CST_CONFIG_CONTROL, val);
+}
+
 static bool vmx_set_cell_config(void)
 {
 	struct cell *cell = this_cell();
+	unsigned long val;
 	u8 *io_bitmap;
 	bool ok = true;
 
@@ -447,9 +724,25 @@ static bool vmx_set_cell_config(void)
 	ok &= vmcs_write64(IO_BITMAP_B,
 			   paging_hvirt2phys(io_bitmap + PAGE_SIZE));
 
-	ok &= vmcs_write64(EPT_POINTER,
-		paging_hvirt2phys(cell->arch.vmx.ept_structs.root_table) |
-		EPT_TYPE_WRITEBACK | EPT_PAGE_WALK_LEN);
+	ok &= vmcs_write64(MSR_BITMAP,
+			   paging_hvirt2phys(cell->arch.vmx.msr_bitmap));
+
+	val = paging_hvirt2phys(cell->arch.vmx.ept_structs.root_table) |
+		EPT_TYPE_WRITEBACK | EPT_PAGE_WALK_LEN;
+	if (cell->config->flags & JAILHOUSE_CELL_DIRTY_LOG)
+		val |= EPT_ENABLE_AD_FLAGS;
+	ok &= vmcs_write64(EPT_POINTER, val);
+
+	val = vmcs_read32(CPU_BASED_VM_EXEC_CONTROL);
+	if (cell->config->flags & JAILHOUSE_CELL_IDLE_POLL)
+		val |= CPU_BASED_HLT_EXITING | CPU_BASED_MWAIT_EXITING |
+			CPU_BASED_MONITOR_EXITING;
+	else
+		val &= ~(CPU_BASED_HLT_EXITING | CPU_BASED_MWAIT_EXITING |
+			 CPU_BASED_MONITOR_EXITING);
+	ok &= vmcs_write32(CPU_BASED_VM_EXEC_CONTROL, val);
+
+	vmx_set_cstate_limit(this_cpu_data(), cell);
 
 	return ok;
 }
@@ -561,14 +854,16 @@ static bool vmcs_setup(struct per_cpu *cpu_data)
 	val &= ~(CPU_BASED_CR3_LOAD_EXITING | CPU_BASED_CR3_STORE_EXITING);
 	ok &= vmcs_write32(CPU_BASED_VM_EXEC_CONTROL, val);
 
-	ok &= vmcs_write64(MSR_BITMAP, paging_hvirt2phys(msr_bitmap));
-
 	val = read_msr(MSR_IA32_VMX_PROCBASED_CTLS2);
 	val |= SECONDARY_EXEC_VIRTUALIZE_APIC_ACCESSES |
 		SECONDARY_EXEC_ENABLE_EPT | SECONDARY_EXEC_UNRESTRICTED_GUEST |
 		secondary_exec_addon;
 	ok &= vmcs_write32(SECONDARY_VM_EXEC_CONTROL, val);
 
+	/* one VPID per CPU, 0 is reserved for the host */
+	if (invvpid_type)
+		ok &= vmcs_write16(VIRTUAL_PROCESSOR_ID, cpu_data->cpu_id + 1);
+
 	ok &= vmcs_write64(APIC_ACCESS_ADDR,
 			   paging_hvirt2phys(apic_access_page));
 
@@ -669,6 +964,9 @@ int vcpu_init(struct per_cpu *cpu_data)
 	    !vmcs_setup(cpu_data))
 		return trace_error(-EIO);
 
+	/* the VPID may still be tagging entries of an earlier activation */
+	vmx_vpid_flush();
+
 	cpu_data->vmx_state = VMCS_READY;
 
 	return 0;
@@ -684,9 +982,17 @@ void vcpu_exit(struct per_cpu *cpu_data)
 	 * the VMCS (a compiler barrier would be sufficient, in fact). */
 	memory_barrier();
 
+	/* no VM entry will follow, so nothing is written back */
+	cpu_data->vmcs_cache.active = false;
+	cpu_data->vmcs_cache.valid = 0;
+
 	vmcs_clear(cpu_data);
 	asm volatile("vmxoff" : : : "cc");
 	cpu_data->linux_cr4 &= ~X86_CR4_VMXE;
+
+	if (cpu_data->pkg_cst_config_saved)
+		write_msr(MSR_PKG_CST_CONFIG_CONTROL,
+			  cpu_data->linux_pkg_cst_config);
 }
 
 void __attribute__((noreturn)) vcpu_activate_vmm(struct per_cpu *cpu_data)
@@ -863,6 +1169,51 @@ void vcpu_vendor_reset(unsigned int sipi_vector)
 		panic_printk("FATAL: CPU reset failed\n");
 		panic_stop();
 	}
+
+	/* the CPU may have switched cells, drop the old guest's entries */
+	vmx_vpid_flush();
+}
+
+void vcpu_vendor_set_long_mode_boot(const struct jailhouse_cell_desc *config)
+{
+	static const struct segment code_seg = {
+		.selector = LONG_MODE_BOOT_CS,
+		.base = 0,
+		.limit = 0xffffffff,
+		.access_rights = 0x0a09b,
+	};
+	static const struct segment data_seg = {
+		.selector = LONG_MODE_BOOT_DS,
+		.base = 0,
+		.limit = 0xffffffff,
+		.access_rights = 0x0c093,
+	};
+	bool ok = true;
+
+	ok &= vmx_set_guest_cr(CR0_IDX, X86_CR0_PG | X86_CR0_WP |
+			       X86_CR0_ET | X86_CR0_PE);
+	ok &= vmx_set_guest_cr(CR4_IDX, X86_CR4_PAE);
+	ok &= vmcs_write64(GUEST_CR3, config->boot_page_table);
+	ok &= vmcs_write64(GUEST_IA32_EFER, EFER_LMA | EFER_LME);
+
+	ok &= vmcs_write64(GUEST_RIP, config->boot_entry);
+
+	ok &= vmx_set_guest_segment(&code_seg, GUEST_CS_SELECTOR);
+	ok &= vmx_set_guest_segment(&data_seg, GUEST_DS_SELECTOR);
+	ok &= vmx_set_guest_segment(&data_seg, GUEST_ES_SELECTOR);
+	ok &= vmx_set_guest_segment(&data_seg, GUEST_SS_SELECTOR);
+
+	ok &= vmcs_write64(GUEST_GDTR_BASE, config->boot_gdt);
+	ok &= vmcs_write32(GUEST_GDTR_LIMIT, config->boot_gdt_limit);
+
+	ok &= vmcs_write32(VM_ENTRY_CONTROLS,
+			   vmcs_read32(VM_ENTRY_CONTROLS) |
+			   VM_ENTRY_IA32E_MODE);
+
+	if (!ok) {
+		panic_printk("FATAL: CPU reset failed\n");
+		panic_stop();
+	}
 }
 
 static void vmx_preemption_timer_set_enable(bool enable)
@@ -890,7 +1241,7 @@ void vcpu_park(void)
 
 void vcpu_skip_emulated_instruction(unsigned int inst_len)
 {
-	vmcs_write64(GUEST_RIP, vmcs_read64(GUEST_RIP) + inst_len);
+	vmcs_write64_deferred(GUEST_RIP, vmcs_read64(GUEST_RIP) + inst_len);
 }
 
 static void vmx_check_events(void)
@@ -904,8 +1255,13 @@ static void vmx_handle_exception_nmi(void)
 	u32 intr_info = vmcs_read32(VM_EXIT_INTR_INFO);
 
 	if ((intr_info & INTR_INFO_INTR_TYPE_MASK) == INTR_TYPE_NMI_INTR) {
+		/*
+		 * The NMI already brought us here, there is no need to run
+		 * vcpu_nmi_handler and arm the preemption timer. NMIs remain
+		 * blocked until the next VM entry, so a kick arriving
+		 * meanwhile causes another exit after it.
+		 */
 		this_cpu_data()->stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
-		asm volatile("int %0" : : "i" (NMI_VECTOR));
 	} else {
 		this_cpu_data()->stats[JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION]++;
 		/*
@@ -927,6 +1283,18 @@ static void vmx_handle_exception_nmi(void)
 	vmx_check_events();
 }
 
+static void vmx_handle_hlt(void)
+{
+	vcpu_skip_emulated_instruction(X86_INST_LEN_HLT);
+
+	/*
+	 * Only a halt with interrupts disabled is meant to be final. Stop the
+	 * CPU for real then. Otherwise, return to the guest so that it polls.
+	 */
+	if (!(vmcs_read64(GUEST_RFLAGS) & X86_RFLAGS_IF))
+		vmcs_write32(GUEST_ACTIVITY_STATE, GUEST_ACTIVITY_HLT);
+}
+
 static void update_efer(void)
 {
 	unsigned long efer = vmcs_read64(GUEST_IA32_EFER);
@@ -961,6 +1329,7 @@ static bool vmx_handle_cr(void)
 			vmx_set_guest_cr(cr ? CR4_IDX : CR0_IDX, val);
 			if (cr == 0 && val & X86_CR0_PG)
 				update_efer();
+			vmx_vpid_flush();
 			return true;
 		}
 		break;
@@ -1082,7 +1451,7 @@ void vcpu_vendor_get_mmio_intercept(struct vcpu_mmio_intercept *mmio)
 	mmio->is_write = !!(exitq & 0x2);
 }
 
-void vcpu_handle_exit(struct per_cpu *cpu_data)
+static void vmx_handle_exit(struct per_cpu *cpu_data)
 {
 	u32 reason = vmcs_read32(VM_EXIT_REASON);
 
@@ -1114,13 +1483,27 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		break;
 	case EXIT_REASON_MSR_WRITE:
 		cpu_data->stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR]++;
-		if (cpu_data->guest_regs.rcx == MSR_IA32_PERF_GLOBAL_CTRL) {
+		/* limited cells must not lift their C-state limit */
+		if (cpu_data->guest_regs.rcx == MSR_IA32_PERF_GLOBAL_CTRL ||
+		    (cpu_data->guest_regs.rcx == MSR_PKG_CST_CONFIG_CONTROL &&
+		     cpu_data->cell->config->flags &
+		     JAILHOUSE_CELL_CSTATE_LIMIT)) {
 			/* ignore writes */
 			vcpu_skip_emulated_instruction(X86_INST_LEN_WRMSR);
 			return;
 		} else if (vcpu_handle_msr_write())
 			return;
 		break;
+	case EXIT_REASON_HLT:
+		vmx_handle_hlt();
+		return;
+	case EXIT_REASON_MWAIT_INSTRUCTION:
+		/* MWAIT may return spuriously, so treat it as NOP */
+		vcpu_skip_emulated_instruction(X86_INST_LEN_MWAIT);
+		return;
+	case EXIT_REASON_MONITOR_INSTRUCTION:
+		vcpu_skip_emulated_instruction(X86_INST_LEN_MONITOR);
+		return;
 	case EXIT_REASON_APIC_ACCESS:
 		cpu_data->stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC]++;
 		if (vmx_handle_apic_access())
@@ -1152,6 +1535,15 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 	panic_park();
 }
 
+void vcpu_handle_exit(struct per_cpu *cpu_data)
+{
+	cpu_data->vmcs_cache.active = true;
+
+	vmx_handle_exit(cpu_data);
+
+	vmcs_cache_flush(&cpu_data->vmcs_cache);
+}
+
 void vmx_entry_failure(void)
 {
 	panic_printk("FATAL: vmresume failed, error %d\n",
@@ -209,6 +209,91 @@ static void cell_exit(struct cell *cell)
 		page_free(&mem_pool, cell->cpu_set, 1);
 }
 
+static bool mem_is_ivshmem_region(struct cell *cell,
+				  const struct jailhouse_memory *mem)
+{
+	const struct jailhouse_pci_device *dev =
+		jailhouse_cell_pci_devices(cell->config);
+	unsigned int region = mem - jailhouse_cell_mem_regions(cell->config);
+	unsigned int n;
+
+	for (n = 0; n < cell->config->num_pci_devices; n++, dev++)
+		if (dev->type == JAILHOUSE_PCI_TYPE_IVSHMEM &&
+		    dev->shmem_region == region)
+			return true;
+	return false;
+}
+
+static unsigned long
+min_large_page_size(const struct paging_structures *pg_structs)
+{
+	const struct paging *paging;
+	unsigned long size = 0;
+
+	for (paging = pg_structs->root_paging; paging->page_size != PAGE_SIZE;
+	     paging++)
+		if (paging->page_size > 0)
+			size = paging->page_size;
+	return size;
+}
+
+/**
+ * Determine the page size a memory region is mapped with in a cell.
+ * @param cell		Cell the region belongs to.
+ * @param mem		Memory region, must be part of the cell configuration.
+ *
+ * @return Smallest page size used for the region or 0 if the region is not
+ * 	   (completely) mapped, e.g. because it is a sub-page region.
+ */
+unsigned long cell_mem_page_size(struct cell *cell,
+				 const struct jailhouse_memory *mem)
+{
+	if (JAILHOUSE_MEMORY_IS_SUBPAGE(mem))
+		return 0;
+	/* colored regions are composed of page-sized chunks */
+	if (mem->flags & JAILHOUSE_MEM_COLORED)
+		return PAGE_SIZE;
+	return paging_get_page_size(arch_get_cell_paging_structs(cell),
+				    mem->virt_start, mem->size);
+}
+
+/**
+ * Validate the page size of a freshly mapped memory region. Regions flagged
+ * with JAILHOUSE_MEM_LARGE_PAGES have to be mapped with large pages only.
+ * The page size of ivshmem regions is reported, with a warning if they fall
+ * back to 4K pages due to their alignment.
+ * @param cell		Cell the region belongs to.
+ * @param mem		Memory region, must be part of the cell configuration.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int cell_check_mem_page_size(struct cell *cell,
+			     const struct jailhouse_memory *mem)
+{
+	unsigned long large_page_size =
+		min_large_page_size(arch_get_cell_paging_structs(cell));
+	unsigned long page_size = cell_mem_page_size(cell, mem);
+	bool misaligned = large_page_size > 0 && page_size < large_page_size &&
+		mem->size >= large_page_size;
+
+	if (mem_is_ivshmem_region(cell, mem))
+		printk("Cell \"%s\": ivshmem region at %p mapped with %d KB "
+		       "pages%s\n", cell->config->name,
+		       (void *)(unsigned long)mem->virt_start,
+		       (int)(page_size / 1024),
+		       misaligned ? ", WARNING: misaligned" : "");
+
+	if (mem->flags & JAILHOUSE_MEM_LARGE_PAGES &&
+	    (large_page_size == 0 || page_size < large_page_size)) {
+		printk("Cell \"%s\": region at %p requires large pages\n",
+		       cell->config->name,
+		       (void *)(unsigned long)mem->virt_start);
+		return trace_error(-EINVAL);
+	}
+
+	return 0;
+}
+
 /**
  * Apply system configuration changes.
  * @param cell_added_removed	Cell that was added or removed to/from the
@@ -239,10 +324,13 @@ static int unmap_from_root_cell(const struct jailhouse_memory *mem)
 	 * arch_unmap_memory_region and mmio_subpage_unregister use the
 	 * virtual address of the memory region for their job. As only the root
 	 * cell has a guaranteed 1:1 mapping, make a copy where we ensure this.
+	 * The root cell maps colored regions completely, so it also has to
+	 * lose all of their pages, not just those of the new cell's colors.
 	 */
 	struct jailhouse_memory tmp = *mem;
 
 	tmp.virt_start = tmp.phys_start;
+	tmp.flags &= ~JAILHOUSE_MEM_COLORED;
 
 	if (JAILHOUSE_MEMORY_IS_SUBPAGE(&tmp)) {
 		mmio_subpage_unregister(&root_cell, &tmp);
@@ -448,6 +536,10 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 			err = arch_map_memory_region(cell, mem);
 		if (err)
 			goto err_destroy_cell;
+
+		err = cell_check_mem_page_size(cell, mem);
+		if (err)
+			goto err_destroy_cell;
 	}
 
 	config_commit(cell);
@@ -666,6 +758,26 @@ static int cell_get_state(struct per_cpu *cpu_data, unsigned long id)
 	return -ENOENT;
 }
 
+static int cell_get_page_size(struct per_cpu *cpu_data, unsigned long id,
+			      unsigned long region)
+{
+	struct cell *cell;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* see cell_get_state for the synchronization */
+	for_each_cell(cell)
+		if (cell->id == id) {
+			if (region >= cell->config->num_memory_regions)
+				return -EINVAL;
+			return cell_mem_page_size(cell,
+				jailhouse_cell_mem_regions(cell->config) +
+				region);
+		}
+	return -ENOENT;
+}
+
 static int shutdown(struct per_cpu *cpu_data)
 {
 	unsigned int this_cpu = cpu_data->cpu_id;
@@ -772,6 +884,148 @@ static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
 		return -EINVAL;
 }
 
+static int cell_set_mem_bw(struct per_cpu *cpu_data, unsigned long id,
+			   unsigned long delay)
+{
+	unsigned int cpu;
+	struct cell *cell;
+	int err = -ENOENT;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* serialize against other management requests of the root cell */
+	cell_suspend(&root_cell, cpu_data);
+
+	for_each_cell(cell)
+		if (cell->id == id) {
+			/* see cell_set_cache */
+			if (cell != &root_cell)
+				cell_suspend(cell, cpu_data);
+
+			err = arch_cell_set_mem_bw(cell, delay);
+
+			if (cell != &root_cell)
+				for_each_cpu(cpu, cell->cpu_set)
+					arch_resume_cpu(cpu);
+			break;
+		}
+
+	cell_resume(cpu_data);
+
+	return err;
+}
+
+static int cell_get_info(struct per_cpu *cpu_data, unsigned long id,
+			 unsigned long type)
+{
+	struct cell *cell;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* see cell_get_state for the synchronization */
+	for_each_cell(cell)
+		if (cell->id == id)
+			return arch_cell_get_info(cell, type);
+	return -ENOENT;
+}
+
+static int cell_set_cache(struct per_cpu *cpu_data, unsigned long id,
+			  unsigned long region)
+{
+	struct jailhouse_cache cache = {
+		.start = JAILHOUSE_CELL_CACHE_START(region),
+		.size = JAILHOUSE_CELL_CACHE_SIZE(region),
+		.type = JAILHOUSE_CELL_CACHE_TYPE(region),
+		.flags = JAILHOUSE_CELL_CACHE_FLAGS(region),
+	};
+	unsigned int cpu;
+	struct cell *cell;
+	int err = -ENOENT;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* serialize against other management requests of the root cell */
+	cell_suspend(&root_cell, cpu_data);
+
+	for_each_cell(cell)
+		if (cell->id == id) {
+			/*
+			 * The cell's CPUs pick up the new masks together on
+			 * resume instead of running with a partial update.
+			 */
+			if (cell != &root_cell)
+				cell_suspend(cell, cpu_data);
+
+			err = arch_cell_set_cache(cell, &cache);
+
+			if (cell != &root_cell)
+				for_each_cpu(cpu, cell->cpu_set)
+					arch_resume_cpu(cpu);
+			break;
+		}
+
+	cell_resume(cpu_data);
+
+	return err;
+}
+
+static int cell_get_dirty_log(struct per_cpu *cpu_data, unsigned long id,
+			      unsigned long log_address)
+{
+	struct jailhouse_dirty_log *log;
+	unsigned int num_pages, cpu;
+	struct cell *cell;
+	int err = -ENOENT;
+
+	if (cpu_data->cell != &root_cell)
+		return -EPERM;
+
+	/* the request shares its page with the bitmap */
+	if (log_address & ~PAGE_MASK)
+		return -EINVAL;
+
+	/* serialize against other management requests of the root cell */
+	cell_suspend(&root_cell, cpu_data);
+
+	for_each_cell(cell)
+		if (cell->id == id)
+			break;
+	if (!cell)
+		goto out_resume;
+
+	log = paging_get_guest_pages(NULL, log_address, 1, PAGE_DEFAULT_FLAGS);
+	if (!log) {
+		err = -ENOMEM;
+		goto out_resume;
+	}
+
+	num_pages = log->num_pages;
+	if (cell == &root_cell || num_pages == 0 ||
+	    num_pages > JAILHOUSE_DIRTY_LOG_MAX_PAGES ||
+	    log->start & ~PAGE_MASK ||
+	    log->flags & ~JAILHOUSE_DIRTY_LOG_ACCESSED) {
+		err = -EINVAL;
+		goto out_resume;
+	}
+
+	/* keep the cell's CPUs from updating the page table flags meanwhile */
+	cell_suspend(cell, cpu_data);
+
+	err = arch_cell_get_dirty_log(cell, log->start, num_pages, log->flags,
+				      log->bitmap);
+
+	for_each_cpu(cpu, cell->cpu_set)
+		arch_resume_cpu(cpu);
+
+out_resume:
+	cell_resume(cpu_data);
+
+	return err;
+}
+
 /**
  * Handle hypercall invoked by a cell.
  * @param code		Hypercall code.
@@ -805,6 +1059,16 @@ long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
 		return cell_get_state(cpu_data, arg1);
 	case JAILHOUSE_HC_CPU_GET_INFO:
 		return cpu_get_info(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_GET_PAGE_SIZE:
+		return cell_get_page_size(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_SET_MEM_BW:
+		return cell_set_mem_bw(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_GET_INFO:
+		return cell_get_info(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_SET_CACHE:
+		return cell_set_cache(cpu_data, arg1, arg2);
+	case JAILHOUSE_HC_CELL_GET_DIRTY_LOG:
+		return cell_get_dirty_log(cpu_data, arg1, arg2);
 	default:
 		return -ENOSYS;
 	}
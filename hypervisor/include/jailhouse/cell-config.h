@@ -42,6 +42,14 @@
 #define JAILHOUSE_CELL_NAME_MAXLEN	31
 
 #define JAILHOUSE_CELL_PASSIVE_COMMREG	0x00000001
+/* x86: intercept HLT, MONITOR and MWAIT, keeping idle CPUs polling in C0 */
+#define JAILHOUSE_CELL_IDLE_POLL	0x00000002
+/* x86 (Intel): apply cstate_limit to the cell's CPUs */
+#define JAILHOUSE_CELL_CSTATE_LIMIT	0x00000004
+/* x86: track written and accessed pages, see JAILHOUSE_HC_CELL_GET_DIRTY_LOG */
+#define JAILHOUSE_CELL_DIRTY_LOG	0x00000008
+/* x86: start the boot CPU in 64-bit mode, see boot_entry */
+#define JAILHOUSE_CELL_LONG_MODE_BOOT	0x00000010
 
 #define JAILHOUSE_CELL_DESC_SIGNATURE	"JAILCELL"
 
@@ -57,6 +65,32 @@ struct jailhouse_cell_desc {
 	__u32 pio_bitmap_size;
 	__u32 num_pci_devices;
 	__u32 num_pci_caps;
+	/** number of MSR whitelist ranges, 0 = default MSR intercepts (x86) */
+	__u32 num_msr_ranges;
+
+	/** memory bandwidth throttling delay (Intel MBA), 0 = unthrottled */
+	__u32 mem_bw_delay;
+	/**
+	 * package C-state limit in MSR_PKG_CST_CONFIG_CONTROL encoding, used
+	 * with JAILHOUSE_CELL_CSTATE_LIMIT
+	 */
+	__u32 cstate_limit;
+
+	/**
+	 * x86: with JAILHOUSE_CELL_LONG_MODE_BOOT, only the boot CPU starts at
+	 * boot_entry in 64-bit mode, using the page tables at boot_page_table
+	 * and the GDT at boot_gdt. As with the Linux 64-bit boot protocol, CS
+	 * is 0x10 and DS, ES and SS are 0x18, so the GDT must provide flat code
+	 * and data segments at these selectors. Secondary CPUs still wait for
+	 * INIT/SIPI and start in real mode at the SIPI vector.
+	 */
+	__u64 boot_entry;
+	__u64 boot_page_table;
+	__u64 boot_gdt;
+	__u32 boot_gdt_limit;
+
+	/** ARM: number of SMMU stream IDs of the cell's DMA masters */
+	__u32 num_stream_ids;
 } __attribute__((packed));
 
 #define JAILHOUSE_MEM_READ		0x0001
@@ -68,6 +102,8 @@ struct jailhouse_cell_desc {
 #define JAILHOUSE_MEM_LOADABLE		0x0040
 #define JAILHOUSE_MEM_ROOTSHARED	0x0080
 #define JAILHOUSE_MEM_IO_UNALIGNED	0x0100
+#define JAILHOUSE_MEM_LARGE_PAGES	0x0200
+#define JAILHOUSE_MEM_COLORED		0x0400
 #define JAILHOUSE_MEM_IO_WIDTH_SHIFT	16 /* uses bits 8..11 */
 #define JAILHOUSE_MEM_IO_8		(1 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
 #define JAILHOUSE_MEM_IO_16		(2 << JAILHOUSE_MEM_IO_WIDTH_SHIFT)
@@ -84,10 +120,26 @@ struct jailhouse_memory {
 #define JAILHOUSE_MEMORY_IS_SUBPAGE(mem)	\
 	((mem)->virt_start & ~PAGE_MASK || (mem)->size & ~PAGE_MASK)
 
+/*
+ * Cache coloring (ARM): A colored memory region is made of blocks of
+ * platform_info.arm.cache_colors pages, each covering one way of the L2 cache.
+ * The cell only gets the pages of its colors, i.e. the pages at index
+ * start..start+size-1 of its JAILHOUSE_CACHE_L2 region within each block, and
+ * sees them as contiguous memory at virt_start. phys_start and size describe
+ * the complete physical range and have to be aligned to the block size.
+ * The root cell keeps its 1:1 mapping and thus uses all colors.
+ * Limitations: the root cell loses the complete region while the cell
+ * exists, also the pages of colors the cell does not use, and gets it back
+ * completely on destruction. Therefore, two cells cannot share one colored
+ * region by using different colors of it. The root cell itself cannot be
+ * colored.
+ */
+
 #define JAILHOUSE_CACHE_L3_CODE		0x01
 #define JAILHOUSE_CACHE_L3_DATA		0x02
 #define JAILHOUSE_CACHE_L3		(JAILHOUSE_CACHE_L3_CODE | \
 					 JAILHOUSE_CACHE_L3_DATA)
+#define JAILHOUSE_CACHE_L2		0x04 /* page colors */
 
 #define JAILHOUSE_CACHE_ROOTSHARED	0x0001
 
@@ -125,8 +177,16 @@ struct jailhouse_pci_device {
 	__u64 msix_address;
 	/** used to refer to memory in virtual PCI devices */
 	__u32 shmem_region;
+	/** ivshmem: doorbell coalescing flags, see JAILHOUSE_IVSHMEM_* */
+	__u32 doorbell_flags;
+	/** ivshmem: minimum TSC cycles between two interrupts per vector */
+	__u32 doorbell_interval;
+	/** ivshmem: offset of the 64-bit pending word in the shared memory */
+	__u32 doorbell_pending_offset;
 } __attribute__((packed));
 
+#define JAILHOUSE_IVSHMEM_DBELL_PENDING	0x0001
+
 #define JAILHOUSE_PCI_EXT_CAP		0x8000
 
 #define JAILHOUSE_PCICAPS_WRITE		0x0001
@@ -138,6 +198,15 @@ struct jailhouse_pci_capability {
 	__u16 flags;
 } __attribute__((packed));
 
+#define JAILHOUSE_MSR_READ		0x0001
+#define JAILHOUSE_MSR_WRITE		0x0002
+
+struct jailhouse_msr_range {
+	__u32 start;
+	__u32 size;
+	__u32 flags;
+} __attribute__((packed));
+
 #define JAILHOUSE_MAX_IOMMU_UNITS	8
 
 struct jailhouse_iommu {
@@ -164,6 +233,13 @@ struct jailhouse_system {
 			struct jailhouse_iommu
 				iommu_units[JAILHOUSE_MAX_IOMMU_UNITS];
 		} __attribute__((packed)) x86;
+		struct {
+			/** L2 way size in pages, power of two, 0 = no coloring */
+			__u32 cache_colors;
+			/** SMMUv2 register base, 0 = no SMMU */
+			__u64 smmu_base;
+			__u32 smmu_size;
+		} __attribute__((packed)) arm;
 	} __attribute__((packed)) platform_info;
 	__u32 interrupt_limit;
 	struct jailhouse_cell_desc root_cell;
@@ -179,7 +255,9 @@ jailhouse_cell_config_size(struct jailhouse_cell_desc *cell)
 		cell->num_irqchips * sizeof(struct jailhouse_irqchip) +
 		cell->pio_bitmap_size +
 		cell->num_pci_devices * sizeof(struct jailhouse_pci_device) +
-		cell->num_pci_caps * sizeof(struct jailhouse_pci_capability);
+		cell->num_pci_caps * sizeof(struct jailhouse_pci_capability) +
+		cell->num_msr_ranges * sizeof(struct jailhouse_msr_range) +
+		cell->num_stream_ids * sizeof(__u32);
 }
 
 static inline __u32
@@ -242,4 +320,19 @@ jailhouse_cell_pci_caps(const struct jailhouse_cell_desc *cell)
 		 cell->num_pci_devices * sizeof(struct jailhouse_pci_device));
 }
 
+static inline const struct jailhouse_msr_range *
+jailhouse_cell_msr_ranges(const struct jailhouse_cell_desc *cell)
+{
+	return (const struct jailhouse_msr_range *)
+		((void *)jailhouse_cell_pci_caps(cell) +
+		 cell->num_pci_caps * sizeof(struct jailhouse_pci_capability));
+}
+
+static inline const __u32 *
+jailhouse_cell_stream_ids(const struct jailhouse_cell_desc *cell)
+{
+	return (const __u32 *)((void *)jailhouse_cell_msr_ranges(cell) +
+		cell->num_msr_ranges * sizeof(struct jailhouse_msr_range));
+}
+
 #endif /* !_JAILHOUSE_CELL_CONFIG_H */
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -122,6 +122,11 @@ bool cpu_id_valid(unsigned long cpu_id);
 
 int cell_init(struct cell *cell);
 
+unsigned long cell_mem_page_size(struct cell *cell,
+				 const struct jailhouse_memory *mem);
+int cell_check_mem_page_size(struct cell *cell,
+			     const struct jailhouse_memory *mem);
+
 void config_commit(struct cell *cell_added_removed);
 
 long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2);
@@ -219,6 +224,16 @@ int arch_map_memory_region(struct cell *cell,
 int arch_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem);
 
+/**
+ * Get the paging structures that translate guest-physical addresses of the
+ * cell's CPUs.
+ * @param cell		Cell to query.
+ *
+ * @return Pointer to the cell's paging structures.
+ */
+const struct paging_structures *
+arch_get_cell_paging_structs(struct cell *cell);
+
 /**
  * Performs the architecture-specific steps for invalidating memory caches
  * after memory regions have been unmapped from a cell.
@@ -248,6 +263,50 @@ int arch_cell_create(struct cell *cell);
  */
 void arch_cell_destroy(struct cell *cell);
 
+/**
+ * Sets the memory bandwidth throttling of a cell at runtime.
+ * @param cell		Cell to be updated.
+ * @param delay		Architecture-specific throttling delay, 0 disables
+ * 			throttling.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int arch_cell_set_mem_bw(struct cell *cell, unsigned long delay);
+
+/**
+ * Retrieves architecture-specific statistics of a cell, e.g. from hardware
+ * resource monitoring.
+ * @param cell		Cell to query.
+ * @param type		Information type (JAILHOUSE_CELL_INFO_*).
+ *
+ * @return Non-negative value on success, negative error code otherwise.
+ */
+int arch_cell_get_info(struct cell *cell, unsigned long type);
+
+/**
+ * Changes a cache partition of a cell at runtime.
+ * @param cell		Cell to be updated.
+ * @param cache		New cache region, replacing the one of the same type.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int arch_cell_set_cache(struct cell *cell,
+			const struct jailhouse_cache *cache);
+
+/**
+ * Collects and resets the dirty or accessed state of cell pages.
+ * @param cell		Cell to inspect, suspended by the caller.
+ * @param start		Guest-physical start address, page-aligned.
+ * @param num_pages	Number of pages to inspect.
+ * @param flags		Request flags (JAILHOUSE_DIRTY_LOG_*).
+ * @param bitmap	Bitmap receiving one bit per page.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int arch_cell_get_dirty_log(struct cell *cell, unsigned long start,
+			    unsigned int num_pages, unsigned long flags,
+			    u8 *bitmap);
+
 /**
  * Performs the architecture-specific steps for applying configuration changes.
  * @param cell_added_removed	Cell that was added or removed to/from the
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013-2015
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -47,6 +47,12 @@
 #define JAILHOUSE_HC_HYPERVISOR_GET_INFO	5
 #define JAILHOUSE_HC_CELL_GET_STATE		6
 #define JAILHOUSE_HC_CPU_GET_INFO		7
+#define JAILHOUSE_HC_IVSHMEM_DOORBELL		8
+#define JAILHOUSE_HC_CELL_GET_PAGE_SIZE		9
+#define JAILHOUSE_HC_CELL_SET_MEM_BW		10
+#define JAILHOUSE_HC_CELL_GET_INFO		11
+#define JAILHOUSE_HC_CELL_SET_CACHE		12
+#define JAILHOUSE_HC_CELL_GET_DIRTY_LOG		13
 
 /* Hypervisor information type */
 #define JAILHOUSE_INFO_MEM_POOL_SIZE		0
@@ -55,6 +61,43 @@
 #define JAILHOUSE_INFO_REMAP_POOL_USED		3
 #define JAILHOUSE_INFO_NUM_CELLS		4
 
+/* Cell information type */
+#define JAILHOUSE_CELL_INFO_L3_OCCUPANCY	0
+#define JAILHOUSE_CELL_INFO_MEM_TRAFFIC_TOTAL	1
+#define JAILHOUSE_CELL_INFO_MEM_TRAFFIC_LOCAL	2
+
+/* Cache region encoding of JAILHOUSE_HC_CELL_SET_CACHE */
+#define JAILHOUSE_CELL_CACHE_REGION(start, size, type, flags)	\
+	((start) | (size) << 8 | (type) << 16 | (flags) << 24)
+#define JAILHOUSE_CELL_CACHE_START(region)	((region) & 0xff)
+#define JAILHOUSE_CELL_CACHE_SIZE(region)	(((region) >> 8) & 0xff)
+#define JAILHOUSE_CELL_CACHE_TYPE(region)	(((region) >> 16) & 0xff)
+#define JAILHOUSE_CELL_CACHE_FLAGS(region)	(((region) >> 24) & 0xff)
+
+/* Flags of JAILHOUSE_HC_CELL_GET_DIRTY_LOG */
+#define JAILHOUSE_DIRTY_LOG_ACCESSED		0x0001
+
+/*
+ * Request of JAILHOUSE_HC_CELL_GET_DIRTY_LOG. It is page-aligned, and the
+ * bitmap fills the rest of the page.
+ */
+struct jailhouse_dirty_log {
+	/** Guest-physical start address in the cell, page-aligned. */
+	__u64 start;
+	/** Number of 4K pages to report, at most
+	 * JAILHOUSE_DIRTY_LOG_MAX_PAGES. */
+	__u32 num_pages;
+	/** Report accessed instead of written pages if
+	 * JAILHOUSE_DIRTY_LOG_ACCESSED is set. */
+	__u32 flags;
+	/** One bit per page, set by the hypervisor if the page was touched
+	 * since the last request. */
+	__u8 bitmap[];
+} __attribute__((packed));
+
+#define JAILHOUSE_DIRTY_LOG_MAX_PAGES	\
+	((4096 - sizeof(struct jailhouse_dirty_log)) * 8)
+
 /* Hypervisor information type */
 #define JAILHOUSE_CPU_INFO_STATE		0
 #define JAILHOUSE_CPU_INFO_STAT_BASE		1000
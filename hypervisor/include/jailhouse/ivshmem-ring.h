@@ -0,0 +1,242 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _JAILHOUSE_IVSHMEM_RING_H
+#define _JAILHOUSE_IVSHMEM_RING_H
+
+/*
+ * Lock-free ring buffer in an ivshmem shared memory region
+ *
+ * The ring consists of a header, separate cache lines for the producer and
+ * the consumer indices and num_slots slots of slot_size bytes. Indices are
+ * free-running 32-bit counters, num_slots has to be a power of two.
+ *
+ * Each side first claims a range of slots by advancing its head, copies the
+ * data and then publishes the range by advancing its tail. With a single
+ * producer or consumer, claiming is a plain store. Multiple producers or
+ * consumers (IVSHMEM_RING_MP/MC) claim via compare-and-swap and publish in
+ * claim order. All operations work on batches, so the other side's index
+ * cache line is only touched once per batch.
+ *
+ * If requested, enqueue reports whether the consumer had caught up with all
+ * previously published slots, i.e. whether the ring turned from empty to
+ * non-empty and the consumer may need a doorbell. A consumer that waits for
+ * doorbells has to check for emptiness again after enabling its interrupt.
+ *
+ * The users of this header have to provide the __u8..__u64 types and
+ * memcpy().
+ */
+
+#define IVSHMEM_RING_MAGIC		0x474e5249 /* "IRNG" */
+#define IVSHMEM_RING_CACHELINE		64
+
+#define IVSHMEM_RING_MP			0x0001
+#define IVSHMEM_RING_MC			0x0002
+
+struct ivshmem_ring_headtail {
+	/* next slot to be claimed */
+	volatile __u32 head;
+	/* all slots before this one are published */
+	volatile __u32 tail;
+} __attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+
+struct ivshmem_ring {
+	volatile __u32 magic;
+	__u32 flags;
+	__u32 num_slots;
+	__u32 slot_size;
+	struct ivshmem_ring_headtail prod;
+	struct ivshmem_ring_headtail cons;
+	__u8 slots[] __attribute__((aligned(IVSHMEM_RING_CACHELINE)));
+};
+
+#define ivshmem_ring_wmb()	__atomic_thread_fence(__ATOMIC_RELEASE)
+#define ivshmem_ring_rmb()	__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define ivshmem_ring_mb()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ivshmem_ring_relax()	asm volatile("pause" : : : "memory")
+#else
+#define ivshmem_ring_relax()	asm volatile("" : : : "memory")
+#endif
+
+static inline unsigned long ivshmem_ring_size(unsigned int num_slots,
+					      unsigned int slot_size)
+{
+	return sizeof(struct ivshmem_ring) +
+		(unsigned long)num_slots * slot_size;
+}
+
+/*
+ * Initializes an empty ring, to be called by one side while the other one
+ * waits for the magic value. Returns 0 on success, -1 on invalid parameters.
+ */
+static inline int ivshmem_ring_init(struct ivshmem_ring *ring,
+				    unsigned int num_slots,
+				    unsigned int slot_size, unsigned int flags)
+{
+	if (num_slots == 0 || (num_slots & (num_slots - 1)) || slot_size == 0)
+		return -1;
+
+	ring->magic = 0;
+	ivshmem_ring_wmb();
+	ring->flags = flags;
+	ring->num_slots = num_slots;
+	ring->slot_size = slot_size;
+	ring->prod.head = ring->prod.tail = 0;
+	ring->cons.head = ring->cons.tail = 0;
+	ivshmem_ring_wmb();
+	ring->magic = IVSHMEM_RING_MAGIC;
+
+	return 0;
+}
+
+static inline int ivshmem_ring_ready(struct ivshmem_ring *ring)
+{
+	if (ring->magic != IVSHMEM_RING_MAGIC)
+		return 0;
+	ivshmem_ring_rmb();
+	return 1;
+}
+
+static inline void *ivshmem_ring_slot(struct ivshmem_ring *ring, __u32 pos)
+{
+	return ring->slots +
+		(unsigned long)(pos & (ring->num_slots - 1)) * ring->slot_size;
+}
+
+static inline int ivshmem_ring_empty(struct ivshmem_ring *ring)
+{
+	return ring->cons.head == ring->prod.tail;
+}
+
+/*
+ * Claims up to count slots. The limit is the other side's tail, capacity
+ * the number of slots that may be claimed ahead of it.
+ */
+static inline unsigned int
+ivshmem_ring_claim(struct ivshmem_ring_headtail *ht, volatile __u32 *limit,
+		   __u32 capacity, int multi, unsigned int count, __u32 *pos)
+{
+	__u32 head, avail;
+
+	do {
+		head = ht->head;
+		avail = capacity + *limit - head;
+		/* the slots must not be accessed before we read the limit */
+		ivshmem_ring_rmb();
+		if (count > avail)
+			count = avail;
+		if (count == 0)
+			return 0;
+		if (!multi) {
+			ht->head = head + count;
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&ht->head, &head, head + count,
+					      0, __ATOMIC_ACQUIRE,
+					      __ATOMIC_RELAXED));
+
+	*pos = head;
+	return count;
+}
+
+static inline void ivshmem_ring_publish(struct ivshmem_ring_headtail *ht,
+					int multi, __u32 pos,
+					unsigned int count)
+{
+	/* earlier claims of other producers or consumers go first */
+	if (multi)
+		while (ht->tail != pos)
+			ivshmem_ring_relax();
+	ivshmem_ring_wmb();
+	ht->tail = pos + count;
+}
+
+/*
+ * Enqueues up to count slots from data and returns the number of enqueued
+ * slots. If notify is non-NULL, it is set to non-zero when the consumer
+ * should be notified about the new slots.
+ */
+static inline unsigned int ivshmem_ring_enqueue(struct ivshmem_ring *ring,
+						const void *data,
+						unsigned int count,
+						int *notify)
+{
+	int multi = ring->flags & IVSHMEM_RING_MP;
+	unsigned int n;
+	__u32 pos;
+
+	count = ivshmem_ring_claim(&ring->prod, &ring->cons.tail,
+				   ring->num_slots, multi, count, &pos);
+	for (n = 0; n < count; n++)
+		memcpy(ivshmem_ring_slot(ring, pos + n),
+		       data + n * ring->slot_size, ring->slot_size);
+	if (count > 0)
+		ivshmem_ring_publish(&ring->prod, multi, pos, count);
+
+	if (notify) {
+		/* order the tail update against reading the consumer head */
+		ivshmem_ring_mb();
+		*notify = count > 0 && ring->cons.head == pos;
+	}
+
+	return count;
+}
+
+/*
+ * Dequeues up to count slots into data and returns the number of dequeued
+ * slots.
+ */
+static inline unsigned int ivshmem_ring_dequeue(struct ivshmem_ring *ring,
+						void *data, unsigned int count)
+{
+	int multi = ring->flags & IVSHMEM_RING_MC;
+	unsigned int n;
+	__u32 pos;
+
+	count = ivshmem_ring_claim(&ring->cons, &ring->prod.tail, 0, multi,
+				   count, &pos);
+	for (n = 0; n < count; n++)
+		memcpy(data + n * ring->slot_size,
+		       ivshmem_ring_slot(ring, pos + n), ring->slot_size);
+	if (count > 0)
+		ivshmem_ring_publish(&ring->cons, multi, pos, count);
+
+	return count;
+}
+
+#endif /* !_JAILHOUSE_IVSHMEM_RING_H */
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013, 2014
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -218,6 +218,10 @@ static inline void *paging_phys2hvirt(unsigned long phys)
 
 unsigned long paging_virt2phys(const struct paging_structures *pg_structs,
 			       unsigned long virt, unsigned long flags);
+unsigned long paging_get_page_size(const struct paging_structures *pg_structs,
+				   unsigned long virt, unsigned long size);
+pt_entry_t paging_get_terminal_entry(const struct paging_structures *pg_structs,
+				     unsigned long virt);
 
 /**
  * Translate guest-physical (cell) address into host-physical address.
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2013, 2014
+ * Copyright (c) Siemens AG, 2013-2016
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -225,6 +225,74 @@ unsigned long paging_virt2phys(const struct paging_structures *pg_structs,
 	}
 }
 
+/**
+ * Determine the smallest page size a range is mapped with.
+ * @param pg_structs	Paging structures to inspect.
+ * @param virt		Start address of the range.
+ * @param size		Size of the range.
+ *
+ * @return Page size in bytes or 0 if the range is not completely mapped.
+ *
+ * @see paging_create
+ */
+unsigned long paging_get_page_size(const struct paging_structures *pg_structs,
+				   unsigned long virt, unsigned long size)
+{
+	unsigned long page_size, min_page_size = 0;
+	unsigned long end = virt + size;
+
+	virt &= PAGE_MASK;
+	while (virt < end) {
+		const struct paging *paging = pg_structs->root_paging;
+		page_table_t pt = pg_structs->root_table;
+		pt_entry_t pte;
+
+		while (1) {
+			pte = paging->get_entry(pt, virt);
+			if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+				return 0;
+			if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR)
+				break;
+			pt = paging_phys2hvirt(paging->get_next_pt(pte));
+			paging++;
+		}
+
+		page_size = paging->page_size;
+		if (min_page_size == 0 || page_size < min_page_size)
+			min_page_size = page_size;
+		/* continue with the next page */
+		virt = (virt & ~(page_size - 1)) + page_size;
+	}
+	return min_page_size;
+}
+
+/**
+ * Look up the terminal page table entry that maps an address.
+ * @param pg_structs	Paging structures to use for the lookup.
+ * @param virt		Virtual address to look up.
+ *
+ * @return Page table entry or NULL if the address is not mapped.
+ *
+ * @note The entry may map a huge page.
+ */
+pt_entry_t paging_get_terminal_entry(const struct paging_structures *pg_structs,
+				     unsigned long virt)
+{
+	const struct paging *paging = pg_structs->root_paging;
+	page_table_t pt = pg_structs->root_table;
+	pt_entry_t pte;
+
+	while (1) {
+		pte = paging->get_entry(pt, virt);
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
+			return NULL;
+		if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR)
+			return pte;
+		pt = paging_phys2hvirt(paging->get_next_pt(pte));
+		paging++;
+	}
+}
+
 static void flush_pt_entry(pt_entry_t pte, enum paging_coherent coherent)
 {
 	if (coherent == PAGING_COHERENT)
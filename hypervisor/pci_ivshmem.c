@@ -21,12 +21,14 @@
 
 #include <jailhouse/control.h>
 #include <jailhouse/mmio.h>
+#include <jailhouse/paging.h>
 #include <jailhouse/pci.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
 #include <jailhouse/utils.h>
 #include <jailhouse/processor.h>
 #include <asm/apic.h>
+#include <asm/bitops.h>
 
 #define VIRTIO_VENDOR_ID	0x1af4
 #define IVSHMEM_DEVICE_ID	0x1110
@@ -37,7 +39,8 @@
 #define IVSHMEM_CFG_SHMEM_PTR	0x40
 #define IVSHMEM_CFG_SHMEM_SZ	0x48
 
-#define IVSHMEM_MSIX_VECTORS	1
+/* the MSI-X shadow table of virtual devices is embedded in pci_device */
+#define IVSHMEM_MAX_MSIX_VECTORS	PCI_EMBEDDED_MSIX_VECTS
 #define IVSHMEM_CFG_MSIX_CAP	0x50
 
 #define IVSHMEM_REG_IVPOS	8
@@ -46,20 +49,31 @@
 #define IVSHMEM_CFG_SIZE	(IVSHMEM_CFG_MSIX_CAP + 12)
 
 #define IVSHMEM_BAR0_SIZE	256
-#define IVSHMEM_BAR4_SIZE	((0x18 * IVSHMEM_MSIX_VECTORS + 0xf) & ~0xf)
+#define IVSHMEM_BAR4_SIZE(vectors)	((0x18 * (vectors) + 0xf) & ~0xf)
+
+/* doorbell: bits 0..15 select the vector, bits 16..31 (peer ID) ignored */
+#define IVSHMEM_DBELL_VECTOR_MASK	0xffff
 
 struct pci_ivshmem_endpoint {
 	u32 cspace[IVSHMEM_CFG_SIZE / sizeof(u32)];
 	u32 ivpos;
+	unsigned int num_vectors;
 	u64 bar0_address;
 	u64 bar4_address;
 	struct pci_device *device;
+	struct pci_ivshmem_data *link;
 	struct pci_ivshmem_endpoint *remote;
-	struct apic_irq_message irq_msg;
+	struct apic_irq_message irq_msg[IVSHMEM_MAX_MSIX_VECTORS];
+	/* doorbell coalescing, applies to interrupts sent to this endpoint */
+	unsigned long interval;
+	unsigned long last_irq[IVSHMEM_MAX_MSIX_VECTORS];
+	unsigned long *pending;
 };
 
 struct pci_ivshmem_data {
 	struct pci_ivshmem_endpoint eps[2];
+	/* serializes doorbells against (dis)connecting an endpoint */
+	spinlock_t lock;
 	struct pci_ivshmem_data *next;
 };
 
@@ -71,28 +85,68 @@ static const u32 default_cspace[IVSHMEM_CFG_SIZE / sizeof(u32)] = {
 	[0x08/4] = PCI_DEV_CLASS_MEM << 24,
 	[0x2c/4] = (IVSHMEM_DEVICE_ID << 16) | VIRTIO_VENDOR_ID,
 	[0x34/4] = IVSHMEM_CFG_MSIX_CAP,
-	/* MSI-X capability */
-	[IVSHMEM_CFG_MSIX_CAP/4] = (0xC000 + IVSHMEM_MSIX_VECTORS - 1) << 16
-				   | (0x00 << 8) | PCI_CAP_MSIX,
+	/* MSI-X capability, table size and PBA offset filled in per device */
+	[IVSHMEM_CFG_MSIX_CAP/4] = (0xC000 << 16) | (0x00 << 8) | PCI_CAP_MSIX,
 	[(IVSHMEM_CFG_MSIX_CAP + 0x4)/4] = PCI_CFG_BAR/8 + 2,
-	[(IVSHMEM_CFG_MSIX_CAP + 0x8)/4] = 0x10 * IVSHMEM_MSIX_VECTORS |
-					   (PCI_CFG_BAR/8 + 2),
+	[(IVSHMEM_CFG_MSIX_CAP + 0x8)/4] = PCI_CFG_BAR/8 + 2,
 };
 
-static void ivshmem_write_doorbell(struct pci_ivshmem_endpoint *ive)
+static void ivshmem_write_doorbell(struct pci_ivshmem_endpoint *ive,
+				   u32 value)
 {
-	struct pci_ivshmem_endpoint *remote = ive->remote;
+	unsigned int vector = value & IVSHMEM_DBELL_VECTOR_MASK;
+	u32 *stats = this_cpu_data()->stats;
+	struct pci_ivshmem_endpoint *remote;
 	struct apic_irq_message irq_msg;
+	unsigned long now = 0;
+
+	stats[JAILHOUSE_CPU_STAT_IVSHMEM_DOORBELLS]++;
+
+	/* the peer cannot disconnect while we hold the lock */
+	spin_lock(&ive->link->lock);
 
+	remote = ive->remote;
 	if (!remote)
-		return;
+		goto out;
+	/* single-vector peers keep the old semantics: any value rings it */
+	if (remote->num_vectors == 1)
+		vector = 0;
+	/* like in Qemu, a doorbell for a non-existing vector is ignored */
+	if (vector >= remote->num_vectors)
+		goto out;
 
 	/* get a copy of the struct before using it, the read barrier makes
 	 * sure the copy is consistent */
-	irq_msg = remote->irq_msg;
+	irq_msg = remote->irq_msg[vector];
 	memory_load_barrier();
-	if (irq_msg.valid)
-		apic_send_irq(irq_msg);
+	if (!irq_msg.valid)
+		goto out;
+
+	/*
+	 * Coalescing: while the minimum interval since the last interrupt has
+	 * not passed, or while the peer has not acknowledged the last
+	 * interrupt by clearing its pending bit, the doorbell is dropped. The
+	 * pending bit is only set for an interrupt that is actually sent.
+	 */
+	if (remote->interval) {
+		now = read_tsc();
+		if (now - remote->last_irq[vector] < remote->interval) {
+			stats[JAILHOUSE_CPU_STAT_IVSHMEM_COALESCED]++;
+			goto out;
+		}
+	}
+	if (remote->pending && test_and_set_bit(vector, remote->pending)) {
+		stats[JAILHOUSE_CPU_STAT_IVSHMEM_COALESCED]++;
+		goto out;
+	}
+	if (remote->interval)
+		remote->last_irq[vector] = now;
+
+	apic_send_irq(irq_msg);
+	stats[JAILHOUSE_CPU_STAT_IVSHMEM_IRQS]++;
+
+out:
+	spin_unlock(&ive->link->lock);
 }
 
 static enum mmio_result ivshmem_register_mmio(void *arg,
@@ -108,7 +162,7 @@ static enum mmio_result ivshmem_register_mmio(void *arg,
 
 	if (mmio->address == IVSHMEM_REG_DBELL) {
 		if (mmio->is_write)
-			ivshmem_write_doorbell(ive);
+			ivshmem_write_doorbell(ive, mmio->value);
 		else
 			mmio->value = 0;
 		return MMIO_HANDLED;
@@ -118,7 +172,8 @@ static enum mmio_result ivshmem_register_mmio(void *arg,
 	return MMIO_ERROR;
 }
 
-static bool ivshmem_is_msix_masked(struct pci_ivshmem_endpoint *ive)
+static bool ivshmem_is_msix_masked(struct pci_ivshmem_endpoint *ive,
+				   unsigned int vector)
 {
 	union pci_msix_registers c;
 
@@ -128,7 +183,7 @@ static bool ivshmem_is_msix_masked(struct pci_ivshmem_endpoint *ive)
 		return true;
 
 	/* local mask */
-	if (ive->device->msix_vectors[0].masked)
+	if (ive->device->msix_vectors[vector].masked)
 		return true;
 
 	/* PCI Bus Master */
@@ -138,23 +193,24 @@ static bool ivshmem_is_msix_masked(struct pci_ivshmem_endpoint *ive)
 	return false;
 }
 
-static int ivshmem_update_msix(struct pci_ivshmem_endpoint *ive)
+static int ivshmem_update_msix_vector(struct pci_ivshmem_endpoint *ive,
+				      unsigned int vector)
 {
 	union x86_msi_vector msi = {
-		.raw.address = ive->device->msix_vectors[0].address,
-		.raw.data = ive->device->msix_vectors[0].data,
+		.raw.address = ive->device->msix_vectors[vector].address,
+		.raw.data = ive->device->msix_vectors[vector].data,
 	};
 	struct apic_irq_message irq_msg;
 
 	/* before doing anything mark the cached irq_msg as invalid,
 	 * on success it will be valid on return. */
-	ive->irq_msg.valid = 0;
+	ive->irq_msg[vector].valid = 0;
 	memory_barrier();
 
-	if (ivshmem_is_msix_masked(ive))
+	if (ivshmem_is_msix_masked(ive, vector))
 		return 0;
 
-	irq_msg = pci_translate_msi_vector(ive->device, 0, 0, msi);
+	irq_msg = pci_translate_msi_vector(ive->device, vector, 0, msi);
 	if (!irq_msg.valid)
 		return 0;
 
@@ -168,13 +224,26 @@ static int ivshmem_update_msix(struct pci_ivshmem_endpoint *ive)
 	/* now copy the whole struct into our cache and mark the cache
 	 * valid at the end */
 	irq_msg.valid = 0;
-	ive->irq_msg = irq_msg;
+	ive->irq_msg[vector] = irq_msg;
 	memory_barrier();
-	ive->irq_msg.valid = 1;
+	ive->irq_msg[vector].valid = 1;
 
 	return 0;
 }
 
+static int ivshmem_update_msix(struct pci_ivshmem_endpoint *ive)
+{
+	unsigned int vector;
+	int err;
+
+	for (vector = 0; vector < ive->num_vectors; vector++) {
+		err = ivshmem_update_msix_vector(ive, vector);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
 static enum mmio_result ivshmem_msix_mmio(void *arg, struct mmio_access *mmio)
 {
 	struct pci_ivshmem_endpoint *ive = arg;
@@ -184,7 +253,7 @@ static enum mmio_result ivshmem_msix_mmio(void *arg, struct mmio_access *mmio)
 		goto fail;
 
 	/* MSI-X PBA */
-	if (mmio->address >= 0x10 * IVSHMEM_MSIX_VECTORS) {
+	if (mmio->address >= 0x10 * ive->num_vectors) {
 		if (mmio->is_write) {
 			goto fail;
 		} else {
@@ -195,7 +264,8 @@ static enum mmio_result ivshmem_msix_mmio(void *arg, struct mmio_access *mmio)
 	} else {
 		if (mmio->is_write) {
 			msix_table[mmio->address / 4] = mmio->value;
-			if (ivshmem_update_msix(ive))
+			if (ivshmem_update_msix_vector(ive,
+						       mmio->address / 0x10))
 				return MMIO_ERROR;
 		} else {
 			mmio->value = msix_table[mmio->address / 4];
@@ -239,8 +309,8 @@ static int ivshmem_write_command(struct pci_ivshmem_endpoint *ive, u16 val)
 
 			ive->bar4_address = (*(u64 *)&device->bar[4]) & ~0xfL;
 			mmio_region_register(device->cell, ive->bar4_address,
-					     IVSHMEM_BAR4_SIZE,
-					     ivshmem_msix_mmio, ive);
+				IVSHMEM_BAR4_SIZE(ive->num_vectors),
+				ivshmem_msix_mmio, ive);
 		}
 		*cmd = (*cmd & ~PCI_CMD_MEM) | (val & PCI_CMD_MEM);
 	}
@@ -292,25 +362,87 @@ static struct pci_ivshmem_data **ivshmem_find(struct pci_device *d,
 	return NULL;
 }
 
-static void ivshmem_connect_cell(struct pci_ivshmem_data *iv,
-				 struct pci_device *d,
-				 const struct jailhouse_memory *mem,
-				 int cellnum)
+static int ivshmem_map_pending(struct pci_ivshmem_endpoint *ive,
+			       const struct jailhouse_memory *mem)
+{
+	unsigned long offset = ive->device->info->doorbell_pending_offset;
+	unsigned long phys = mem->phys_start + offset;
+	void *page;
+	int err;
+
+	if (offset % sizeof(unsigned long) ||
+	    offset + sizeof(unsigned long) > mem->size)
+		return trace_error(-EINVAL);
+
+	page = page_alloc(&remap_pool, 1);
+	if (!page)
+		return -ENOMEM;
+
+	err = paging_create(&hv_paging_structs, phys & PAGE_MASK, PAGE_SIZE,
+			    (unsigned long)page, PAGE_DEFAULT_FLAGS,
+			    PAGING_NON_COHERENT);
+	if (err) {
+		page_free(&remap_pool, page, 1);
+		return err;
+	}
+
+	ive->pending = page + (phys & ~PAGE_MASK);
+	return 0;
+}
+
+static void ivshmem_unmap_pending(struct pci_ivshmem_endpoint *ive)
+{
+	void *page = (void *)((unsigned long)ive->pending & PAGE_MASK);
+
+	if (!ive->pending)
+		return;
+
+	/* cannot fail, destruction of same size as construction */
+	paging_destroy(&hv_paging_structs, (unsigned long)page, PAGE_SIZE,
+		       PAGING_NON_COHERENT);
+	page_free(&remap_pool, page, 1);
+	ive->pending = NULL;
+}
+
+static int ivshmem_connect_cell(struct pci_ivshmem_data *iv,
+				struct pci_device *d,
+				const struct jailhouse_memory *mem,
+				int cellnum)
 {
 	struct pci_ivshmem_endpoint *remote = &iv->eps[(cellnum + 1) % 2];
 	struct pci_ivshmem_endpoint *ive = &iv->eps[cellnum];
+	unsigned int vector;
+	int err;
+
+	ive->device = d;
+	ive->link = iv;
+	ive->pending = NULL;
+	if (d->info->doorbell_flags & JAILHOUSE_IVSHMEM_DBELL_PENDING) {
+		err = ivshmem_map_pending(ive, mem);
+		if (err) {
+			ive->device = NULL;
+			return err;
+		}
+	}
+	ive->interval = d->info->doorbell_interval;
+	for (vector = 0; vector < IVSHMEM_MAX_MSIX_VECTORS; vector++)
+		ive->last_irq[vector] = 0;
 
 	d->bar[0] = PCI_BAR_64BIT;
 	d->bar[4] = PCI_BAR_64BIT;
 
 	memcpy(ive->cspace, &default_cspace, sizeof(default_cspace));
 
+	ive->num_vectors = d->info->num_msix_vectors;
+	ive->cspace[IVSHMEM_CFG_MSIX_CAP/4] |= (ive->num_vectors - 1) << 16;
+	ive->cspace[(IVSHMEM_CFG_MSIX_CAP + 0x8)/4] |= 0x10 * ive->num_vectors;
+
 	ive->cspace[IVSHMEM_CFG_SHMEM_PTR/4] = (u32)mem->virt_start;
 	ive->cspace[IVSHMEM_CFG_SHMEM_PTR/4 + 1] = (u32)(mem->virt_start >> 32);
 	ive->cspace[IVSHMEM_CFG_SHMEM_SZ/4] = (u32)mem->size;
 	ive->cspace[IVSHMEM_CFG_SHMEM_SZ/4 + 1] = (u32)(mem->size >> 32);
 
-	ive->device = d;
+	spin_lock(&iv->lock);
 	if (remote->device) {
 		ive->remote = remote;
 		remote->remote = ive;
@@ -320,7 +452,10 @@ static void ivshmem_connect_cell(struct pci_ivshmem_data *iv,
 		ive->remote = NULL;
 		remote->remote = NULL;
 	}
+	spin_unlock(&iv->lock);
 	d->ivshmem_endpoint = ive;
+
+	return 0;
 }
 
 static void ivshmem_disconnect_cell(struct pci_ivshmem_data *iv, int cellnum)
@@ -335,8 +470,17 @@ static void ivshmem_disconnect_cell(struct pci_ivshmem_data *iv, int cellnum)
 	}
 	ive->device->ivshmem_endpoint = NULL;
 	ive->device = NULL;
+
+	/*
+	 * Once the peer can no longer find us under the lock, no doorbell of
+	 * it is in flight that could still touch our pending word.
+	 */
+	spin_lock(&iv->lock);
 	ive->remote = NULL;
 	remote->remote = NULL;
+	spin_unlock(&iv->lock);
+
+	ivshmem_unmap_pending(ive);
 }
 
 /**
@@ -394,6 +538,35 @@ enum pci_access pci_ivshmem_cfg_read(struct pci_device *device, u16 address,
 	return PCI_ACCESS_DONE;
 }
 
+/**
+ * Ring the doorbell of an ivshmem device without going through the MMIO path.
+ * @param cell		The cell issuing the doorbell.
+ * @param bdf		BDF of the ivshmem device in that cell.
+ * @param value		Doorbell value, selects the vector of the peer.
+ *
+ * This is the backend of the ivshmem doorbell hypercall. It has the same
+ * semantic as a write to the doorbell register but does not require to
+ * decode the guest's access.
+ *
+ * @return 0 on success, negative error code otherwise.
+ */
+int pci_ivshmem_doorbell(struct cell *cell, u16 bdf, u32 value)
+{
+	struct pci_device *device = pci_get_assigned_device(cell, bdf);
+	struct pci_ivshmem_endpoint *ive;
+
+	if (!device || device->info->type != JAILHOUSE_PCI_TYPE_IVSHMEM)
+		return -ENOENT;
+
+	/* like the register, the doorbell requires memory decoding */
+	ive = device->ivshmem_endpoint;
+	if (!(ive->cspace[PCI_CFG_COMMAND/4] & PCI_CMD_MEM))
+		return -EPERM;
+
+	ivshmem_write_doorbell(ive, value);
+	return 0;
+}
+
 /**
  * Update cached MSI-X state of the given ivshmem device.
  * @param device	The device to be updated.
@@ -417,8 +590,15 @@ int pci_ivshmem_init(struct cell *cell, struct pci_device *device)
 	const struct jailhouse_memory *mem, *mem0;
 	struct pci_ivshmem_data **ivp;
 	struct pci_device *dev0;
+	int err;
+
+	if (device->info->num_msix_vectors < 1 ||
+	    device->info->num_msix_vectors > IVSHMEM_MAX_MSIX_VECTORS)
+		return trace_error(-EINVAL);
 
-	if (device->info->num_msix_vectors != 1)
+	/* the guest must size BAR4 to cover the MSI-X table and PBA we trap */
+	if ((u32)(~(device->info->bar_mask[4] & ~0xf) + 1) <
+	    IVSHMEM_BAR4_SIZE(device->info->num_msix_vectors))
 		return trace_error(-EINVAL);
 
 	if (device->info->shmem_region >= cell->config->num_memory_regions)
@@ -437,7 +617,9 @@ int pci_ivshmem_init(struct cell *cell, struct pci_device *device)
 		    (mem0->size == mem->size)) {
 			if ((*ivp)->eps[1].device)
 				return trace_error(-EBUSY);
-			ivshmem_connect_cell(*ivp, device, mem, 1);
+			err = ivshmem_connect_cell(*ivp, device, mem, 1);
+			if (err)
+				return err;
 			printk("Virtual PCI connection established "
 				"\"%s\" <--> \"%s\"\n",
 				cell->config->name, dev0->cell->config->name);
@@ -451,7 +633,12 @@ int pci_ivshmem_init(struct cell *cell, struct pci_device *device)
 	*ivp = page_alloc(&mem_pool, 1);
 	if (!(*ivp))
 		return -ENOMEM;
-	ivshmem_connect_cell(*ivp, device, mem, 0);
+	err = ivshmem_connect_cell(*ivp, device, mem, 0);
+	if (err) {
+		page_free(&mem_pool, *ivp, 1);
+		*ivp = NULL;
+		return err;
+	}
 
 connected:
 	printk("Adding virtual PCI device %02x:%02x.%x to cell \"%s\"\n",
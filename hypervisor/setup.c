@@ -129,6 +129,10 @@ int map_root_memory_regions(void)
 			err = arch_map_memory_region(&root_cell, mem);
 		if (err)
 			return err;
+
+		err = cell_check_mem_page_size(&root_cell, mem);
+		if (err)
+			return err;
 	}
 	return 0;
 }
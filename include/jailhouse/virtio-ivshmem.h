@@ -0,0 +1,295 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _JAILHOUSE_VIRTIO_IVSHMEM_H
+#define _JAILHOUSE_VIRTIO_IVSHMEM_H
+
+/*
+ * virtio transport over an ivshmem shared memory region
+ *
+ * The region starts with struct virtio_ivshmem_header, followed by the split
+ * virtqueues and a buffer area owned by the driver. As both sides may map the
+ * region at different addresses, descriptor addresses are offsets relative to
+ * the start of the region and must point into it. The device (backend)
+ * prepares the header and the queue layout, the driver (frontend) initializes
+ * the queues and sets DRIVER_OK. Notifications are ivshmem doorbells. The
+ * device signals queue n via vector n, the driver always uses vector 0 so
+ * that the backend can run with a single interrupt, e.g. one eventfd.
+ *
+ * The users of this header have to provide the __u8..__u64 types.
+ */
+
+#define VIRTIO_IVSHMEM_MAGIC		0x56534956 /* "VIVS" */
+#define VIRTIO_IVSHMEM_REVISION		1
+
+#define VIRTIO_IVSHMEM_MAX_QUEUES	8
+#define VIRTIO_IVSHMEM_CONFIG_SIZE	64
+
+#define VIRTIO_ID_NET			1
+#define VIRTIO_ID_CONSOLE		3
+
+#define VIRTIO_STATUS_ACKNOWLEDGE	0x01
+#define VIRTIO_STATUS_DRIVER		0x02
+#define VIRTIO_STATUS_DRIVER_OK		0x04
+#define VIRTIO_STATUS_FEATURES_OK	0x08
+#define VIRTIO_STATUS_FAILED		0x80
+
+#define VIRTIO_NET_F_MAC		5
+#define VIRTIO_RING_F_EVENT_IDX		29
+
+#define VRING_DESC_F_NEXT		1
+#define VRING_DESC_F_WRITE		2
+
+#define VRING_AVAIL_F_NO_INTERRUPT	1
+#define VRING_USED_F_NO_NOTIFY		1
+
+#define VIRTIO_IVSHMEM_VRING_ALIGN	64
+
+struct virtio_ivshmem_header {
+	__u32 magic;
+	__u32 revision;
+	__u32 device_id;
+	__u32 status;
+	__u64 device_features;
+	__u64 driver_features;
+	__u32 num_queues;
+	__u32 queue_size;
+	__u32 queue_offset[VIRTIO_IVSHMEM_MAX_QUEUES];
+	__u32 buffer_offset;
+	__u32 buffer_size;
+	__u8 config[VIRTIO_IVSHMEM_CONFIG_SIZE];
+} __attribute__((packed));
+
+struct virtio_net_hdr {
+	__u8 flags;
+	__u8 gso_type;
+	__u16 hdr_len;
+	__u16 gso_size;
+	__u16 csum_start;
+	__u16 csum_offset;
+} __attribute__((packed));
+
+struct vring_desc {
+	__u64 addr;
+	__u32 len;
+	__u16 flags;
+	__u16 next;
+};
+
+struct vring_avail {
+	__u16 flags;
+	__u16 idx;
+	__u16 ring[];
+};
+
+struct vring_used_elem {
+	__u32 id;
+	__u32 len;
+};
+
+struct vring_used {
+	__u16 flags;
+	__u16 idx;
+	struct vring_used_elem ring[];
+};
+
+/* Local view on a virtqueue, not shared between the two sides. */
+struct virtio_ivshmem_vq {
+	unsigned int num;
+	volatile struct vring_desc *desc;
+	volatile struct vring_avail *avail;
+	volatile struct vring_used *used;
+	/* event index fields behind the avail and the used ring */
+	volatile __u16 *used_event;
+	volatile __u16 *avail_event;
+	/* driver: next free descriptor, device: next avail entry to fetch */
+	__u16 next;
+	/* shadow of the index this side publishes, written out in batches */
+	__u16 shadow_idx;
+	/* the other side's index we consumed up to */
+	__u16 last_idx;
+};
+
+#define virtio_ivshmem_wmb()	__atomic_thread_fence(__ATOMIC_RELEASE)
+#define virtio_ivshmem_rmb()	__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define virtio_ivshmem_mb()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+static inline unsigned long vring_align(unsigned long offset)
+{
+	return (offset + VIRTIO_IVSHMEM_VRING_ALIGN - 1) &
+		~(VIRTIO_IVSHMEM_VRING_ALIGN - 1UL);
+}
+
+static inline unsigned long vring_size(unsigned int num)
+{
+	return vring_align(sizeof(struct vring_desc) * num +
+			   sizeof(__u16) * (3 + num)) +
+		vring_align(sizeof(__u16) * 3 +
+			    sizeof(struct vring_used_elem) * num);
+}
+
+static inline void vring_setup(struct virtio_ivshmem_vq *vq, void *base,
+			       unsigned int num)
+{
+	vq->num = num;
+	vq->desc = base;
+	vq->avail = base + sizeof(struct vring_desc) * num;
+	vq->used = base + vring_align(sizeof(struct vring_desc) * num +
+				      sizeof(__u16) * (3 + num));
+	vq->used_event = &vq->avail->ring[num];
+	vq->avail_event = (void *)&vq->used->ring[num];
+	vq->next = 0;
+	vq->shadow_idx = 0;
+	vq->last_idx = 0;
+}
+
+/* Returns true if moving from old to new_idx crossed event_idx. */
+static inline int vring_need_event(__u16 event_idx, __u16 new_idx, __u16 old)
+{
+	return (__u16)(new_idx - event_idx - 1) < (__u16)(new_idx - old);
+}
+
+/*
+ * Driver side: queue a single-descriptor buffer. The buffer only becomes
+ * visible to the device with vring_driver_publish(), which allows to batch
+ * several buffers per index update and notification. Descriptors are used
+ * round-robin, so at most num buffers may be in flight.
+ */
+static inline void vring_driver_add(struct virtio_ivshmem_vq *vq, __u64 offset,
+				    __u32 len, int device_writes)
+{
+	__u16 head = vq->next;
+
+	vq->desc[head].addr = offset;
+	vq->desc[head].len = len;
+	vq->desc[head].flags = device_writes ? VRING_DESC_F_WRITE : 0;
+	vq->desc[head].next = 0;
+	vq->avail->ring[vq->shadow_idx % vq->num] = head;
+	vq->next = (head + 1) % vq->num;
+	vq->shadow_idx++;
+}
+
+/* Publishes all added buffers, returns non-zero if the device needs a kick */
+static inline int vring_driver_publish(struct virtio_ivshmem_vq *vq)
+{
+	__u16 old = vq->avail->idx;
+
+	virtio_ivshmem_wmb();
+	vq->avail->idx = vq->shadow_idx;
+	virtio_ivshmem_mb();
+
+	return vring_need_event(*vq->avail_event, vq->shadow_idx, old);
+}
+
+/*
+ * Driver side: fetch the next buffer the device returned, if any. Returning 0
+ * means that the queue is empty and the next device publish will request an
+ * interrupt, so the caller can wait for it.
+ */
+static inline int vring_driver_get_used(struct virtio_ivshmem_vq *vq,
+					__u32 *id, __u32 *len)
+{
+	volatile struct vring_used_elem *elem;
+
+	if (vq->last_idx == vq->used->idx) {
+		/*
+		 * Ask for the next interrupt, then re-check: the device may
+		 * have published before it could see the new event index and
+		 * thus skipped the interrupt, see vring_device_publish().
+		 */
+		*vq->used_event = vq->last_idx;
+		virtio_ivshmem_mb();
+		if (vq->last_idx == vq->used->idx)
+			return 0;
+	}
+	virtio_ivshmem_rmb();
+
+	elem = &vq->used->ring[vq->last_idx % vq->num];
+	*id = elem->id;
+	*len = elem->len;
+	vq->last_idx++;
+	/* ask for the next interrupt once we caught up */
+	*vq->used_event = vq->last_idx;
+
+	return 1;
+}
+
+/*
+ * Device side: fetch the next available buffer, returns its head. As for the
+ * driver, returning 0 re-enables notifications before the caller waits.
+ */
+static inline int vring_device_get_avail(struct virtio_ivshmem_vq *vq,
+					 __u16 *head)
+{
+	if (vq->last_idx == vq->avail->idx) {
+		/* re-arm the notification and re-check, see above */
+		*vq->avail_event = vq->last_idx;
+		virtio_ivshmem_mb();
+		if (vq->last_idx == vq->avail->idx)
+			return 0;
+	}
+	virtio_ivshmem_rmb();
+
+	*head = vq->avail->ring[vq->last_idx % vq->num];
+	vq->last_idx++;
+	*vq->avail_event = vq->last_idx;
+
+	return 1;
+}
+
+static inline void vring_device_add_used(struct virtio_ivshmem_vq *vq,
+					 __u16 head, __u32 len)
+{
+	volatile struct vring_used_elem *elem =
+		&vq->used->ring[vq->shadow_idx % vq->num];
+
+	elem->id = head;
+	elem->len = len;
+	vq->shadow_idx++;
+}
+
+/* Publishes all used buffers, returns non-zero if the driver needs an IRQ */
+static inline int vring_device_publish(struct virtio_ivshmem_vq *vq)
+{
+	__u16 old = vq->used->idx;
+
+	virtio_ivshmem_wmb();
+	vq->used->idx = vq->shadow_idx;
+	virtio_ivshmem_mb();
+
+	return vring_need_event(*vq->used_event, vq->shadow_idx, old);
+}
+
+#endif /* !_JAILHOUSE_VIRTIO_IVSHMEM_H */
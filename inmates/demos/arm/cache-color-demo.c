@@ -0,0 +1,140 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * L2 cache isolation benchmark for cache coloring. By default, the inmate
+ * repeatedly walks a working set that fits into its share of the L2 cache and
+ * reports the walk duration. With "pollute" on the command line, it sweeps a
+ * buffer larger than its L2 share instead. Run one instance of each mode in
+ * two cells, e.g. with the jetson-tk1-cache-color-demo and
+ * jetson-tk1-cache-pollute-demo configurations. With disjoint colors, the
+ * walk duration is not affected by the polluter. Drop the cache region and
+ * the JAILHOUSE_MEM_COLORED flags from the configurations to compare.
+ */
+
+#include <asm/sysregs.h>
+#include <inmate.h>
+
+#define CMDLINE_BUFFER_SIZE	256
+CMDLINE_BUFFER(CMDLINE_BUFFER_SIZE);
+
+#define WS_BASE			0x20000
+#define WS_SIZE			(256 * 1024)
+#define POLLUTE_BASE		0x100000
+#define POLLUTE_SIZE		(2 * 1024 * 1024)
+
+#define CACHE_LINE_SIZE		64
+#define WS_LINES		(WS_SIZE / CACHE_LINE_SIZE)
+
+#define ROUNDS			256
+
+/* short-descriptor section mappings, identity-mapping the address space */
+#define NUM_SECTIONS		4096
+#define SECTION_SIZE		0x100000
+#define SECTION_TYPE		0x2
+#define SECTION_B		(1 << 2)
+#define SECTION_C		(1 << 3)
+#define SECTION_AP_RW		(3 << 10)
+#define SECTION_TEX(tex)	((tex) << 12)
+#define SECTION_NORMAL_WB	(SECTION_TEX(1) | SECTION_C | SECTION_B)
+#define SECTION_DEVICE		SECTION_B
+
+/* the first 16 MB are RAM, the rest is treated as device memory */
+#define RAM_SECTIONS		16
+
+#define DACR_CLIENT(domain)	(1 << ((domain) * 2))
+
+#define SCTLR_M			(1 << 0)
+#define SCTLR_C			(1 << 2)
+#define SCTLR_I			(1 << 12)
+
+static u32 page_table[NUM_SECTIONS] __attribute__((aligned(16 * 1024)));
+
+/* Without the stage-1 MMU, data accesses would bypass the caches. */
+static void enable_caches(void)
+{
+	unsigned int n;
+	u32 sctlr;
+
+	for (n = 0; n < NUM_SECTIONS; n++)
+		page_table[n] = n * SECTION_SIZE | SECTION_TYPE |
+			SECTION_AP_RW | (n < RAM_SECTIONS ?
+					 SECTION_NORMAL_WB : SECTION_DEVICE);
+
+	arm_write_sysreg(TTBCR, 0);
+	arm_write_sysreg(TTBR0_EL1, (unsigned long)page_table);
+	arm_write_sysreg(DACR, DACR_CLIENT(0));
+	arm_write_sysreg(TLBIALL, 0);
+	arm_write_sysreg(ICIALLU, 0);
+	asm volatile("dsb; isb" : : : "memory");
+
+	arm_read_sysreg(SCTLR_EL1, sctlr);
+	arm_write_sysreg(SCTLR_EL1, sctlr | SCTLR_M | SCTLR_C | SCTLR_I);
+	asm volatile("isb" : : : "memory");
+}
+
+static void walk(unsigned long base, unsigned long size)
+{
+	unsigned long n;
+
+	for (n = 0; n < size; n += CACHE_LINE_SIZE)
+		(void)*(volatile u32 *)(base + n);
+}
+
+static void pollute(unsigned long base, unsigned long size)
+{
+	volatile u32 *mem;
+	unsigned long n;
+
+	for (n = 0; n < size; n += CACHE_LINE_SIZE) {
+		mem = (u32 *)(base + n);
+		*mem ^= 0xaa;
+	}
+}
+
+void inmate_main(void)
+{
+	u64 start, delta, min, max, sum;
+	unsigned long avg_ns;
+	unsigned int n;
+
+	enable_caches();
+
+	if (cmdline_parse_bool("pollute")) {
+		printk("Cache color demo: polluting %d KB\n",
+		       POLLUTE_SIZE / 1024);
+		while (1)
+			pollute(POLLUTE_BASE, POLLUTE_SIZE);
+	}
+
+	printk("Cache color demo: walking %d KB working set\n",
+	       WS_SIZE / 1024);
+	walk(WS_BASE, WS_SIZE);
+
+	while (1) {
+		min = ~0ULL;
+		max = sum = 0;
+
+		for (n = 0; n < ROUNDS; n++) {
+			start = timer_get_ticks();
+			walk(WS_BASE, WS_SIZE);
+			delta = timer_get_ticks() - start;
+
+			if (delta < min)
+				min = delta;
+			if (delta > max)
+				max = delta;
+			sum += delta;
+		}
+
+		avg_ns = timer_ticks_to_ns(sum / ROUNDS);
+		printk("walk: min %6ld ns, avg %6ld ns, max %6ld ns, "
+		       "avg %3ld ns/line\n", (long)timer_ticks_to_ns(min),
+		       avg_ns, (long)timer_ticks_to_ns(max),
+		       avg_ns / WS_LINES);
+	}
+}
@@ -10,6 +10,11 @@
  *
  * This work is licensed under the terms of the GNU GPL, version 2.  See
  * the COPYING file in the top-level directory.
+ *
+ * With "irq_latency" on the command line, the demo measures the latency of
+ * virtual IRQ injection instead: it sends SGIs to itself, which the
+ * hypervisor intercepts and injects back, and reports the time until the
+ * handler runs.
  */
 
 #include <mach/timer.h>
@@ -20,15 +25,28 @@ CMDLINE_BUFFER(CMDLINE_BUFFER_SIZE);
 
 #define BEATS_PER_SEC		10
 
+#define BENCH_SGI		1
+#define BENCH_ROUNDS		10000
+
 static u64 ticks_per_beat;
 static volatile u64 expected_ticks;
 static bool blinking_led;
 
+static volatile u64 sgi_sent_ticks, sgi_latency;
+static volatile bool sgi_received;
+
 static void handle_IRQ(unsigned int irqn)
 {
 	static u64 min_delta = ~0ULL, max_delta = 0;
 	u64 delta;
 
+	/* strip the source CPU ID of SGIs */
+	if ((irqn & 0x3ff) == BENCH_SGI) {
+		sgi_latency = timer_get_ticks() - sgi_sent_ticks;
+		sgi_received = true;
+		return;
+	}
+
 	if (irqn != TIMER_IRQ)
 		return;
 
@@ -55,10 +73,47 @@ static void handle_IRQ(unsigned int irqn)
 	timer_start(ticks_per_beat);
 }
 
+static void irq_latency_bench(void)
+{
+	u64 min, max, sum;
+	unsigned int n;
+
+	printk("Measuring virtual IRQ injection latency...\n");
+	gic_enable_irq(BENCH_SGI);
+
+	while (1) {
+		min = ~0ULL;
+		max = sum = 0;
+
+		for (n = 0; n < BENCH_ROUNDS; n++) {
+			sgi_received = false;
+			sgi_sent_ticks = timer_get_ticks();
+			gic_send_self_sgi(BENCH_SGI);
+			while (!sgi_received)
+				asm volatile("" : : : "memory");
+
+			if (sgi_latency < min)
+				min = sgi_latency;
+			if (sgi_latency > max)
+				max = sgi_latency;
+			sum += sgi_latency;
+		}
+
+		printk("SGI latency: min %6ld ns, avg %6ld ns, max %6ld ns\n",
+		       (long)timer_ticks_to_ns(min),
+		       (long)timer_ticks_to_ns(sum / BENCH_ROUNDS),
+		       (long)timer_ticks_to_ns(max));
+	}
+}
+
 void inmate_main(void)
 {
 	printk("Initializing the GIC...\n");
 	gic_setup(handle_IRQ);
+
+	if (cmdline_parse_bool("irq_latency"))
+		irq_latency_bench();
+
 	gic_enable_irq(TIMER_IRQ);
 
 	printk("Initializing the timer...\n");
@@ -30,6 +30,15 @@ CMDLINE_BUFFER(CMDLINE_BUFFER_SIZE);
 
 static unsigned long expected_time;
 static unsigned long min = -1, max;
+static bool tsc_deadline;
+
+static void timer_set(unsigned long timeout_ns)
+{
+	if (tsc_deadline)
+		tsc_deadline_set(timeout_ns);
+	else
+		apic_timer_set(timeout_ns);
+}
 
 static void irq_handler(void)
 {
@@ -44,7 +53,7 @@ static void irq_handler(void)
 	       delta, min, max);
 
 	expected_time += 100 * NS_PER_MSEC;
-	apic_timer_set(expected_time - tsc_read());
+	timer_set(expected_time - tsc_read());
 }
 
 static void init_apic(void)
@@ -54,11 +63,21 @@ static void init_apic(void)
 	int_init();
 	int_set_handler(APIC_TIMER_VECTOR, irq_handler);
 
-	apic_freq_khz = apic_timer_init(APIC_TIMER_VECTOR);
-	printk("Calibrated APIC frequency: %lu kHz\n", apic_freq_khz);
+	if (cmdline_parse_bool("tsc_deadline")) {
+		tsc_deadline = tsc_deadline_init(APIC_TIMER_VECTOR) == 0;
+		if (!tsc_deadline)
+			printk("TSC deadline timer not available\n");
+	}
+
+	if (tsc_deadline) {
+		printk("Using TSC deadline timer\n");
+	} else {
+		apic_freq_khz = apic_timer_init(APIC_TIMER_VECTOR);
+		printk("Calibrated APIC frequency: %lu kHz\n", apic_freq_khz);
+	}
 
 	expected_time = tsc_read() + NS_PER_MSEC;
-	apic_timer_set(NS_PER_MSEC);
+	timer_set(NS_PER_MSEC);
 
 	asm volatile("sti");
 }
@@ -0,0 +1,118 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Instruction fetch benchmark for L3 code/data prioritization. A code block
+ * that touches one cache line per instruction is timed while cached and
+ * after sweeping a data buffer that is larger than the cell's L3 partition.
+ * With separate code and data partitions (cat-cdp-demo cell configuration),
+ * the sweep cannot evict the code from L3, and the refetch stays close to
+ * L3 latency. Change the configuration to a single JAILHOUSE_CACHE_L3 region
+ * of the same total size to compare against a unified partition.
+ */
+
+#include <inmate.h>
+
+#define CMDLINE_BUFFER_SIZE	256
+CMDLINE_BUFFER(CMDLINE_BUFFER_SIZE);
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+#define POLLUTE_BASE		0x200000
+#define POLLUTE_SIZE		(16 * 1024 * 1024)
+
+#define CODE_LINES		512
+#define CACHE_LINE_SIZE		64
+
+#define ROUNDS			1000
+
+#define __stringify_1(x)	#x
+#define __stringify(x)		__stringify_1(x)
+
+/* one taken jump per cache line, CODE_LINES * 64 bytes in total */
+void code_block(void);
+asm(".pushsection .text\n\t"
+    ".balign " __stringify(CACHE_LINE_SIZE) "\n"
+    "code_block:\n\t"
+    ".rept " __stringify(CODE_LINES) "\n\t"
+    "jmp 1f\n\t"
+    ".balign " __stringify(CACHE_LINE_SIZE) "\n"
+    "1:\n\t"
+    ".endr\n\t"
+    "ret\n\t"
+    ".popsection");
+
+struct result {
+	unsigned long min, max, sum;
+};
+
+static void pollute_cache(unsigned long size)
+{
+	volatile char *mem = (char *)POLLUTE_BASE;
+	unsigned long n;
+
+	for (n = 0; n < size; n += CACHE_LINE_SIZE)
+		mem[n] ^= 0xaa;
+}
+
+static void record(struct result *res, unsigned long delta)
+{
+	if (delta < res->min)
+		res->min = delta;
+	if (delta > res->max)
+		res->max = delta;
+	res->sum += delta;
+}
+
+static void report(const char *name, struct result *res)
+{
+	unsigned long avg = res->sum / ROUNDS;
+
+	printk("%s min %6ld ns, avg %6ld ns, max %6ld ns, "
+	       "avg %3ld.%02ld ns/line\n", name, res->min, avg, res->max,
+	       avg / CODE_LINES, (avg * 100 / CODE_LINES) % 100);
+}
+
+void inmate_main(void)
+{
+	struct result cached = { .min = -1 }, polluted = { .min = -1 };
+	unsigned long pollute_size, start;
+	unsigned int n;
+
+	printk_uart_base = UART_BASE;
+
+	pollute_size = cmdline_parse_int("pollute_size", POLLUTE_SIZE);
+	if (pollute_size > POLLUTE_SIZE)
+		pollute_size = POLLUTE_SIZE;
+
+	tsc_init();
+	map_range((void *)POLLUTE_BASE, POLLUTE_SIZE, MAP_CACHED);
+
+	printk("CAT/CDP demo: %d code lines, polluting %ld KB of data\n",
+	       CODE_LINES, pollute_size / 1024);
+
+	for (n = 0; n < ROUNDS; n++) {
+		code_block();
+		start = tsc_read();
+		code_block();
+		record(&cached, tsc_read() - start);
+
+		pollute_cache(pollute_size);
+		start = tsc_read();
+		code_block();
+		record(&polluted, tsc_read() - start);
+	}
+
+	report("cached:  ", &cached);
+	report("polluted:", &polluted);
+
+	asm volatile("cli; hlt");
+}
@@ -102,7 +102,8 @@ static void send_irq(struct ivshmem_dev_data *d)
 {
 	printk("IVSHMEM: %02x:%02x.%x sending IRQ\n",
 	       d->bdf >> 8, (d->bdf >> 3) & 0x1f, d->bdf & 0x3);
-	mmio_write32(d->registers + 3, 1);
+	/* doorbell value selects the MSI-X vector of the peer */
+	mmio_write32(d->registers + 3, 0);
 }
 
 static void irq_handler(void)
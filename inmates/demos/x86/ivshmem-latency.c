@@ -0,0 +1,170 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Round-trip latency benchmark for ivshmem doorbells. Run it in two cells
+ * that are linked via an ivshmem device. The cell with IVPosition 0 sends
+ * doorbells and measures the time until the peer rang back, the other cell
+ * just echoes every interrupt it receives. Both the doorbell register and
+ * the doorbell hypercall are measured.
+ */
+
+#include <inmate.h>
+
+#define VENDORID		0x1af4
+#define DEVICEID		0x1110
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define IVSHMEM_REG_IVPOS	(8 / 4)
+#define IVSHMEM_REG_DBELL	(12 / 4)
+
+#define IRQ_VECTOR		32
+
+#define ROUNDS			10000
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+enum doorbell_mode {
+	MODE_MMIO,
+	MODE_HYPERCALL,
+};
+
+/* layout of the beginning of the shared memory region */
+struct latency_shmem {
+	volatile u32 ready[2];
+	volatile u32 mode;
+};
+
+static u16 bdf;
+static u32 *registers;
+static struct latency_shmem *shmem;
+static unsigned int ivpos;
+static volatile unsigned int irq_counter;
+
+static u64 pci_cfg_read64(u16 bdf, unsigned int addr)
+{
+	return ((u64)pci_read_config(bdf, addr + 4, 4) << 32) |
+		pci_read_config(bdf, addr, 4);
+}
+
+static void pci_cfg_write64(u16 bdf, unsigned int addr, u64 val)
+{
+	pci_write_config(bdf, addr + 4, (u32)(val >> 32), 4);
+	pci_write_config(bdf, addr, (u32)val, 4);
+}
+
+static void ring_doorbell(void)
+{
+	if (shmem->mode == MODE_HYPERCALL)
+		jailhouse_call_arg2(JAILHOUSE_HC_IVSHMEM_DOORBELL, bdf, 0);
+	else
+		mmio_write32(registers + IVSHMEM_REG_DBELL, 0);
+}
+
+static void irq_handler(void)
+{
+	irq_counter++;
+	if (ivpos != 0)
+		ring_doorbell();
+}
+
+static void map_device(void)
+{
+	u64 shmemsz = pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_SZ);
+	void *msix_table;
+
+	shmem = (void *)pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_PTR);
+	registers = (u32 *)(((u64)shmem + shmemsz + PAGE_SIZE - 1) &
+			    PAGE_MASK);
+	msix_table = (void *)registers + PAGE_SIZE;
+
+	pci_cfg_write64(bdf, PCI_CFG_BAR, (u64)registers);
+	pci_cfg_write64(bdf, PCI_CFG_BAR + 16, (u64)msix_table);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM | PCI_CMD_MASTER,
+			 2);
+
+	map_range(shmem, shmemsz + 2 * PAGE_SIZE, MAP_UNCACHED);
+}
+
+static void measure(enum doorbell_mode mode, const char *name)
+{
+	unsigned long min = -1, max = 0, sum = 0, start, delta;
+	unsigned int expected, n;
+
+	shmem->mode = mode;
+
+	for (n = 0; n < ROUNDS; n++) {
+		expected = irq_counter + 1;
+		start = tsc_read();
+		ring_doorbell();
+		while (irq_counter != expected)
+			cpu_relax();
+		delta = tsc_read() - start;
+
+		if (delta < min)
+			min = delta;
+		if (delta > max)
+			max = delta;
+		sum += delta;
+	}
+
+	printk("%-9s round-trip: min %6ld ns, avg %6ld ns, max %6ld ns\n",
+	       name, min, sum / ROUNDS, max);
+}
+
+void inmate_main(void)
+{
+	int result;
+
+	printk_uart_base = UART_BASE;
+
+	hypercall_init();
+	int_init();
+	tsc_init();
+
+	result = pci_find_device(VENDORID, DEVICEID, 0);
+	if (result < 0) {
+		printk("IVSHMEM: no device found\n");
+		goto out;
+	}
+	bdf = result;
+
+	map_device();
+	ivpos = mmio_read32(registers + IVSHMEM_REG_IVPOS);
+	printk("IVSHMEM: %02x:%02x.%x, position %d\n", bdf >> 8,
+	       (bdf >> 3) & 0x1f, bdf & 0x3, ivpos);
+
+	int_set_handler(IRQ_VECTOR, irq_handler);
+	pci_msix_set_vector(bdf, IRQ_VECTOR, 0);
+	asm volatile("sti");
+
+	shmem->ready[ivpos] = 1;
+	if (ivpos != 0) {
+		printk("Echoing doorbells\n");
+		while (1)
+			asm volatile("hlt");
+	}
+
+	printk("Waiting for peer\n");
+	while (!shmem->ready[1])
+		cpu_relax();
+
+	while (1) {
+		measure(MODE_MMIO, "MMIO");
+		measure(MODE_HYPERCALL, "hypercall");
+		delay_us(1000 * 1000);
+	}
+
+out:
+	asm volatile("cli; hlt");
+}
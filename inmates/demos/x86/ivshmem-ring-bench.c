@@ -0,0 +1,336 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Throughput and latency benchmark for the ivshmem ring buffer. Run it in two
+ * cells that are linked via an ivshmem device. The cell with IVPosition 0
+ * produces messages and reports the results, the other one consumes them,
+ * either polling or waiting for doorbells, and echoes them for the latency
+ * test.
+ */
+
+#include <inmate.h>
+
+#define VENDORID		0x1af4
+#define DEVICEID		0x1110
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define IVSHMEM_REG_IVPOS	(8 / 4)
+#define IVSHMEM_REG_DBELL	(12 / 4)
+
+#define IRQ_VECTOR		32
+
+#define RING_SLOTS		256
+#define MAX_BATCH		32
+#define MESSAGES		(1024 * 1024)
+#define ROUNDS			10000
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+enum bench_test {
+	TEST_POLL,
+	TEST_DOORBELL,
+	TEST_PING_PONG,
+};
+
+struct message {
+	u64 seq;
+	u64 payload[7];
+};
+
+/*
+ * Layout of the shared memory: the control page, followed by the ring from
+ * position 0 to 1 and the one back.
+ */
+struct bench_ctrl {
+	volatile u32 ready[2];
+	volatile u32 test;
+	volatile u32 batch;
+	volatile u32 run;
+	volatile u32 done;
+	volatile u32 errors;
+};
+
+static u16 bdf;
+static u32 *registers;
+static void *shmem;
+static u64 shmem_size;
+static struct bench_ctrl *ctrl;
+static struct ivshmem_ring *ring_tx, *ring_rx;
+static volatile unsigned int irq_counter;
+
+static u64 pci_cfg_read64(u16 bdf, unsigned int addr)
+{
+	return ((u64)pci_read_config(bdf, addr + 4, 4) << 32) |
+		pci_read_config(bdf, addr, 4);
+}
+
+static void pci_cfg_write64(u16 bdf, unsigned int addr, u64 val)
+{
+	pci_write_config(bdf, addr + 4, (u32)(val >> 32), 4);
+	pci_write_config(bdf, addr, (u32)val, 4);
+}
+
+static void irq_handler(void)
+{
+	irq_counter++;
+}
+
+static void map_device(void)
+{
+	shmem = (void *)pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_PTR);
+	shmem_size = pci_cfg_read64(bdf, IVSHMEM_CFG_SHMEM_SZ);
+	registers = (u32 *)(((u64)shmem + shmem_size + PAGE_SIZE - 1) &
+			    PAGE_MASK);
+
+	pci_cfg_write64(bdf, PCI_CFG_BAR, (u64)registers);
+	pci_cfg_write64(bdf, PCI_CFG_BAR + 16, (u64)registers + PAGE_SIZE);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM | PCI_CMD_MASTER,
+			 2);
+
+	map_range(shmem, shmem_size, MAP_CACHED);
+	map_range(registers, 2 * PAGE_SIZE, MAP_UNCACHED);
+}
+
+static int setup_rings(unsigned int ivpos)
+{
+	unsigned long ring_area =
+		(ivshmem_ring_size(RING_SLOTS, sizeof(struct message)) +
+		 PAGE_SIZE - 1) & PAGE_MASK;
+	void *rings = shmem + PAGE_SIZE;
+
+	if (PAGE_SIZE + 2 * ring_area > shmem_size)
+		return -1;
+
+	ctrl = shmem;
+	ring_tx = rings + (ivpos == 0 ? 0 : ring_area);
+	ring_rx = rings + (ivpos == 0 ? ring_area : 0);
+
+	return 0;
+}
+
+static void wait_for_doorbell(struct ivshmem_ring *ring)
+{
+	asm volatile("cli");
+	if (ivshmem_ring_empty(ring))
+		asm volatile("sti; hlt" : : : "memory");
+	else
+		asm volatile("sti");
+}
+
+/* position 1: receive MESSAGES messages, checking their sequence */
+static void consume(unsigned int batch, bool doorbell)
+{
+	struct message msgs[MAX_BATCH];
+	unsigned long received = 0;
+	unsigned int n, count;
+
+	while (received < MESSAGES) {
+		count = ivshmem_ring_dequeue(ring_rx, msgs, batch);
+		if (count == 0) {
+			if (doorbell)
+				wait_for_doorbell(ring_rx);
+			else
+				cpu_relax();
+			continue;
+		}
+		for (n = 0; n < count; n++, received++)
+			if (msgs[n].seq != received)
+				ctrl->errors++;
+	}
+}
+
+/* position 1: return every message to the sender */
+static void echo(void)
+{
+	struct message msg;
+	unsigned int n;
+
+	for (n = 0; n < ROUNDS; n++) {
+		while (ivshmem_ring_dequeue(ring_rx, &msg, 1) == 0)
+			cpu_relax();
+		while (ivshmem_ring_enqueue(ring_tx, &msg, 1, NULL) == 0)
+			cpu_relax();
+	}
+}
+
+static void peer_main(void)
+{
+	unsigned int run = 0;
+
+	/* position 0 resets the control block before signaling readiness */
+	while (!ctrl->ready[0])
+		cpu_relax();
+
+	while (1) {
+		while (ctrl->run == run)
+			cpu_relax();
+		run = ctrl->run;
+
+		switch (ctrl->test) {
+		case TEST_POLL:
+			consume(ctrl->batch, false);
+			break;
+		case TEST_DOORBELL:
+			consume(ctrl->batch, true);
+			break;
+		case TEST_PING_PONG:
+			echo();
+			break;
+		}
+		ctrl->done = run;
+	}
+}
+
+static void start_test(enum bench_test test, unsigned int batch)
+{
+	ivshmem_ring_init(ring_tx, RING_SLOTS, sizeof(struct message), 0);
+	ivshmem_ring_init(ring_rx, RING_SLOTS, sizeof(struct message), 0);
+	ctrl->test = test;
+	ctrl->batch = batch;
+	ctrl->errors = 0;
+	ivshmem_ring_wmb();
+	ctrl->run++;
+}
+
+static void wait_for_peer(void)
+{
+	while (ctrl->done != ctrl->run)
+		cpu_relax();
+}
+
+static void measure_throughput(unsigned int batch, bool doorbell)
+{
+	struct message msgs[MAX_BATCH];
+	unsigned long sent = 0, doorbells = 0, start, delta;
+	unsigned int n, count;
+	int notify;
+
+	memset(msgs, 0, sizeof(msgs));
+	start_test(doorbell ? TEST_DOORBELL : TEST_POLL, batch);
+
+	start = tsc_read();
+	while (sent < MESSAGES) {
+		for (n = 0; n < batch; n++)
+			msgs[n].seq = sent + n;
+		count = batch;
+		if (count > MESSAGES - sent)
+			count = MESSAGES - sent;
+		count = ivshmem_ring_enqueue(ring_tx, msgs, count,
+					     doorbell ? &notify : NULL);
+		if (count == 0) {
+			cpu_relax();
+			continue;
+		}
+		sent += count;
+		if (doorbell && notify) {
+			mmio_write32(registers + IVSHMEM_REG_DBELL, 0);
+			doorbells++;
+		}
+	}
+	wait_for_peer();
+	delta = tsc_read() - start;
+
+	printk("%-8s batch %2d: %6ld kmsg/s, %5ld MB/s, %4ld doorbells per "
+	       "1000 messages, %d errors\n", doorbell ? "doorbell" : "polling",
+	       batch, MESSAGES * (NS_PER_SEC / 1000) / delta,
+	       MESSAGES * sizeof(struct message) * (NS_PER_SEC / 1000) /
+	       delta / 1000, doorbells * 1000 / MESSAGES, ctrl->errors);
+}
+
+static void measure_latency(void)
+{
+	unsigned long min = -1, max = 0, sum = 0, start, delta;
+	struct message msg;
+	unsigned int n;
+
+	memset(&msg, 0, sizeof(msg));
+	start_test(TEST_PING_PONG, 1);
+
+	for (n = 0; n < ROUNDS; n++) {
+		msg.seq = n;
+		start = tsc_read();
+		ivshmem_ring_enqueue(ring_tx, &msg, 1, NULL);
+		while (ivshmem_ring_dequeue(ring_rx, &msg, 1) == 0)
+			cpu_relax();
+		delta = tsc_read() - start;
+
+		if (delta < min)
+			min = delta;
+		if (delta > max)
+			max = delta;
+		sum += delta;
+	}
+	wait_for_peer();
+
+	printk("ping-pong round-trip: min %6ld ns, avg %6ld ns, "
+	       "max %6ld ns\n", min, sum / ROUNDS, max);
+}
+
+void inmate_main(void)
+{
+	static const unsigned int batches[] = { 1, 8, MAX_BATCH };
+	unsigned int ivpos, n;
+	int result;
+
+	printk_uart_base = UART_BASE;
+
+	int_init();
+	tsc_init();
+
+	result = pci_find_device(VENDORID, DEVICEID, 0);
+	if (result < 0) {
+		printk("IVSHMEM: no device found\n");
+		goto out;
+	}
+	bdf = result;
+
+	map_device();
+	ivpos = mmio_read32(registers + IVSHMEM_REG_IVPOS);
+	printk("IVSHMEM: %02x:%02x.%x, position %d\n", bdf >> 8,
+	       (bdf >> 3) & 0x1f, bdf & 0x3, ivpos);
+	if (setup_rings(ivpos) < 0) {
+		printk("IVSHMEM: shared memory too small\n");
+		goto out;
+	}
+
+	int_set_handler(IRQ_VECTOR, irq_handler);
+	pci_msix_set_vector(bdf, IRQ_VECTOR, 0);
+	asm volatile("sti");
+
+	if (ivpos != 0) {
+		ctrl->ready[1] = 1;
+		printk("Consuming messages\n");
+		peer_main();
+	}
+
+	ctrl->run = ctrl->done = 0;
+	ivshmem_ring_wmb();
+	ctrl->ready[0] = 1;
+
+	printk("Waiting for peer\n");
+	while (!ctrl->ready[1])
+		cpu_relax();
+
+	while (1) {
+		for (n = 0; n < sizeof(batches) / sizeof(batches[0]); n++)
+			measure_throughput(batches[n], false);
+		for (n = 0; n < sizeof(batches) / sizeof(batches[0]); n++)
+			measure_throughput(batches[n], true);
+		measure_latency();
+		delay_us(1000 * 1000);
+	}
+
+out:
+	asm volatile("cli; hlt");
+}
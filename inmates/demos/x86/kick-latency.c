@@ -0,0 +1,82 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Management event benchmark. The inmate polls the TSC and records each gap
+ * above a threshold as interruption by the hypervisor. Once per second, the
+ * number of gaps and their duration are reported. Trigger management events
+ * for this cell from the root cell, e.g. by repeatedly resizing its cache
+ * partition:
+ *
+ *   while true; do
+ *       jailhouse cell set-cache kick-latency 0 2
+ *       jailhouse cell set-cache kick-latency 0 3
+ *   done
+ *
+ * Each update kicks the cell's CPU, and the reported gap duration is the
+ * cost of that kick as seen by the guest.
+ */
+
+#include <inmate.h>
+
+#define CMDLINE_BUFFER_SIZE	256
+CMDLINE_BUFFER(CMDLINE_BUFFER_SIZE);
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+#define THRESHOLD_NS		500
+
+void inmate_main(void)
+{
+	unsigned long min, max, sum, count, threshold;
+	unsigned long now, last, delta, next_report;
+
+	printk_uart_base = UART_BASE;
+
+	threshold = cmdline_parse_int("threshold", THRESHOLD_NS);
+
+	tsc_init();
+
+	printk("Kick latency: recording gaps above %ld ns\n", threshold);
+
+	min = -1;
+	max = sum = count = 0;
+	last = tsc_read();
+	next_report = last + NS_PER_SEC;
+	while (1) {
+		now = tsc_read();
+		delta = now - last;
+		last = now;
+
+		if (delta > threshold) {
+			if (delta < min)
+				min = delta;
+			if (delta > max)
+				max = delta;
+			sum += delta;
+			count++;
+		}
+
+		if (now >= next_report) {
+			if (count > 0)
+				printk("gaps: %6ld, min %6ld ns, avg %6ld ns, "
+				       "max %6ld ns\n", count, min,
+				       sum / count, max);
+			else
+				printk("gaps: none\n");
+			min = -1;
+			max = sum = count = 0;
+			next_report += NS_PER_SEC;
+			/* do not account for the printk */
+			last = tsc_read();
+		}
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * TLB retention benchmark. A set of pages that fits into the data TLB is
+ * touched while its translations are cached and directly after a VM exit
+ * (CPUID). If the hypervisor tags guest TLB entries (VPID/ASID), both
+ * measurements are close. Otherwise, the exit flushes the TLB, and the
+ * accesses after the exit pay for full two-dimensional page walks. Run it
+ * e.g. with the apic-demo cell configuration.
+ */
+
+#include <inmate.h>
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+#define TEST_BASE		0xc0000
+#define TEST_PAGES		64
+#define CACHE_LINE_SIZE		64
+
+#define ROUNDS			10000
+
+struct result {
+	unsigned long min, max, sum;
+};
+
+/* one line per page, each in a different cache set */
+static void touch_pages(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < TEST_PAGES; n++)
+		(void)*(volatile u32 *)(TEST_BASE + n * PAGE_SIZE +
+					n * CACHE_LINE_SIZE);
+}
+
+static void vm_exit(void)
+{
+	unsigned int eax = 0, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid"
+		: "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx)
+		: : "memory");
+}
+
+static void record(struct result *res, unsigned long delta)
+{
+	if (delta < res->min)
+		res->min = delta;
+	if (delta > res->max)
+		res->max = delta;
+	res->sum += delta;
+}
+
+static void report(const char *name, struct result *res)
+{
+	unsigned long avg = res->sum / ROUNDS;
+
+	printk("%s min %6ld ns, avg %6ld ns, max %6ld ns, "
+	       "avg %3ld.%02ld ns/page\n", name, res->min, avg, res->max,
+	       avg / TEST_PAGES, (avg * 100 / TEST_PAGES) % 100);
+}
+
+void inmate_main(void)
+{
+	struct result cached = { .min = -1 }, after_exit = { .min = -1 };
+	unsigned long start;
+	unsigned int n;
+
+	printk_uart_base = UART_BASE;
+
+	tsc_init();
+
+	printk("TLB demo: touching %d pages\n", TEST_PAGES);
+
+	for (n = 0; n < ROUNDS; n++) {
+		touch_pages();
+		start = tsc_read();
+		touch_pages();
+		record(&cached, tsc_read() - start);
+
+		vm_exit();
+		start = tsc_read();
+		touch_pages();
+		record(&after_exit, tsc_read() - start);
+	}
+
+	report("cached:    ", &cached);
+	report("after exit:", &after_exit);
+
+	asm volatile("cli; hlt");
+}
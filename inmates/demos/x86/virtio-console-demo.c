@@ -0,0 +1,120 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * virtio-console over ivshmem: echoes everything received from the root cell
+ * backend (tools/jailhouse-virtio-backend) and sends a greeting every second.
+ */
+
+#include <inmate.h>
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe010
+#else
+#define UART_BASE		0x3f8
+#endif
+
+#define IRQ_VECTOR		32
+#define RX_QUEUE		0
+#define TX_QUEUE		1
+
+#define BUFFER_SIZE		256
+#define RX_BUFFERS		16
+#define TX_BUFFERS		16
+
+static struct virtio_ivshmem_dev dev;
+static unsigned int tx_next, tx_in_flight;
+
+static void irq_handler(void)
+{
+}
+
+/* the first RX_BUFFERS for receiving, then TX_BUFFERS for sending */
+static unsigned long buffer_offset(unsigned int n)
+{
+	return (dev.buffers - dev.shmem) + n * BUFFER_SIZE;
+}
+
+static void send(const char *data, unsigned int len)
+{
+	struct virtio_ivshmem_vq *vq = &dev.vqs[TX_QUEUE];
+	unsigned long offset;
+	u32 id, used_len;
+
+	/* transmit buffers complete in order, just count them */
+	do {
+		while (vring_driver_get_used(vq, &id, &used_len))
+			tx_in_flight--;
+	} while (tx_in_flight == TX_BUFFERS);
+
+	offset = buffer_offset(RX_BUFFERS + tx_next);
+	memcpy(dev.shmem + offset, data, len);
+	vring_driver_add(vq, offset, len, 0);
+	tx_next = (tx_next + 1) % TX_BUFFERS;
+	tx_in_flight++;
+
+	if (vring_driver_publish(vq))
+		virtio_ivshmem_kick(&dev);
+}
+
+void inmate_main(void)
+{
+	struct virtio_ivshmem_vq *rx_vq;
+	unsigned long next_greeting;
+	unsigned int n, greetings = 0;
+	unsigned long offset;
+	char msg[] = "Hello from virtio-console  \n";
+	u32 id, len;
+
+	printk_uart_base = UART_BASE;
+
+	int_init();
+	tsc_init();
+	int_set_handler(IRQ_VECTOR + RX_QUEUE, irq_handler);
+	int_set_handler(IRQ_VECTOR + TX_QUEUE, irq_handler);
+
+	printk("virtio-console: waiting for backend\n");
+	if (virtio_ivshmem_init(&dev, VIRTIO_ID_CONSOLE,
+				1ULL << VIRTIO_RING_F_EVENT_IDX,
+				IRQ_VECTOR) < 0) {
+		printk("virtio-console: no device found\n");
+		goto out;
+	}
+	printk("virtio-console: device %02x:%02x.%x ready\n", dev.bdf >> 8,
+	       (dev.bdf >> 3) & 0x1f, dev.bdf & 0x3);
+
+	rx_vq = &dev.vqs[RX_QUEUE];
+	for (n = 0; n < RX_BUFFERS; n++)
+		vring_driver_add(rx_vq, buffer_offset(n), BUFFER_SIZE, 1);
+	if (vring_driver_publish(rx_vq))
+		virtio_ivshmem_kick(&dev);
+
+	asm volatile("sti");
+
+	next_greeting = tsc_read();
+	while (1) {
+		if (tsc_read() >= next_greeting) {
+			msg[sizeof(msg) - 3] = '0' + greetings++ % 10;
+			send(msg, sizeof(msg) - 1);
+			next_greeting += NS_PER_SEC;
+		}
+
+		while (vring_driver_get_used(rx_vq, &id, &len)) {
+			offset = rx_vq->desc[id].addr;
+			send(dev.shmem + offset, len);
+			/* repost the buffer */
+			vring_driver_add(rx_vq, offset, BUFFER_SIZE, 1);
+			if (vring_driver_publish(rx_vq))
+				virtio_ivshmem_kick(&dev);
+		}
+
+		delay_us(1000);
+	}
+
+out:
+	asm volatile("cli; hlt");
+}
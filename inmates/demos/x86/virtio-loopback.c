@@ -0,0 +1,123 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Local loopback benchmark for the virtio-over-ivshmem queues. The first CPU
+ * runs the driver side, the second one the device side of a single queue in
+ * local memory. For different batch sizes, the throughput and the number of
+ * notifications that would turn into doorbells are reported. Use the
+ * smp-demo cell configuration to run it.
+ */
+
+#include <inmate.h>
+
+#ifdef CONFIG_UART_OXPCIE952
+#define UART_BASE		0xe000
+#else
+#define UART_BASE		0x2f8
+#endif
+
+#define QUEUE_SIZE		256
+#define MSG_SIZE		64
+#define MESSAGES		(1024 * 1024)
+
+static void *region;
+static struct virtio_ivshmem_vq driver_vq, device_vq;
+static volatile unsigned long device_kicks;
+static volatile bool device_ready;
+
+static void device_main(void)
+{
+	unsigned long sink = 0;
+	unsigned int pending = 0;
+	volatile struct vring_desc *desc;
+	u16 head;
+
+	device_ready = true;
+	while (1) {
+		while (vring_device_get_avail(&device_vq, &head)) {
+			desc = &device_vq.desc[head];
+			sink += *(volatile u64 *)(region + desc->addr);
+			vring_device_add_used(&device_vq, head, desc->len);
+			pending++;
+		}
+		if (pending) {
+			if (vring_device_publish(&device_vq))
+				device_kicks++;
+			pending = 0;
+		}
+		cpu_relax();
+	}
+}
+
+static void run(unsigned int batch)
+{
+	unsigned long sent = 0, completed = 0, kicks = 0, irqs, start, delta;
+	unsigned long offset = vring_size(QUEUE_SIZE);
+	unsigned int n;
+	u32 id, len;
+
+	irqs = device_kicks;
+	start = tsc_read();
+
+	while (completed < MESSAGES) {
+		for (n = 0; n < batch && sent < MESSAGES &&
+		     sent - completed < QUEUE_SIZE; n++, sent++) {
+			*(u64 *)(region + offset + driver_vq.next * MSG_SIZE) =
+				sent;
+			vring_driver_add(&driver_vq,
+					 offset + driver_vq.next * MSG_SIZE,
+					 MSG_SIZE, 0);
+		}
+		if (n > 0 && vring_driver_publish(&driver_vq))
+			kicks++;
+
+		while (vring_driver_get_used(&driver_vq, &id, &len))
+			completed++;
+	}
+
+	delta = tsc_read() - start;
+	irqs = device_kicks - irqs;
+
+	printk("batch %3d: %6ld kmsg/s, %4ld.%02ld kicks and %4ld.%02ld IRQs "
+	       "per 100 messages\n", batch,
+	       MESSAGES * (NS_PER_SEC / 1000) / delta,
+	       kicks * 100 / MESSAGES, (kicks * 10000 / MESSAGES) % 100,
+	       irqs * 100 / MESSAGES, (irqs * 10000 / MESSAGES) % 100);
+}
+
+void inmate_main(void)
+{
+	unsigned long size = vring_size(QUEUE_SIZE) + QUEUE_SIZE * MSG_SIZE;
+	static const unsigned int batches[] = { 1, 4, 16, 64, QUEUE_SIZE };
+	unsigned int n;
+
+	printk_uart_base = UART_BASE;
+
+	smp_wait_for_all_cpus();
+	if (smp_num_cpus < 2) {
+		printk("virtio loopback requires two CPUs\n");
+		goto out;
+	}
+
+	tsc_init();
+
+	region = alloc(size, VIRTIO_IVSHMEM_VRING_ALIGN);
+	memset(region, 0, size);
+	vring_setup(&driver_vq, region, QUEUE_SIZE);
+	vring_setup(&device_vq, region, QUEUE_SIZE);
+
+	smp_start_cpu(smp_cpu_ids[1], device_main);
+	while (!device_ready)
+		cpu_relax();
+
+	for (n = 0; n < sizeof(batches) / sizeof(batches[0]); n++)
+		run(batches[n]);
+
+out:
+	asm volatile("cli; hlt");
+}
@@ -22,6 +22,9 @@
 
 #define GICC_PMR_DEFAULT	0xf0
 
+#define GICD_SGIR		0x0f00
+#define GICD_SGIR_SELF		(2 << 24)
+
 void gic_enable(unsigned int irqn)
 {
 	mmio_write32(GICD_BASE + GICD_ISENABLER, 1 << irqn);
@@ -44,3 +47,8 @@ u32 gic_read_ack(void)
 {
 	return mmio_read32(GICC_BASE + GICC_IAR);
 }
+
+void gic_send_self_sgi(unsigned int sgi)
+{
+	mmio_write32(GICD_BASE + GICD_SGIR, GICD_SGIR_SELF | sgi);
+}
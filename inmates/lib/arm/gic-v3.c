@@ -22,6 +22,7 @@
 #define ICC_PMR_EL1		SYSREG_32(0, c4, c6, 0)
 #define ICC_CTLR_EL1		SYSREG_32(0, c12, c12, 4)
 #define ICC_IGRPEN1_EL1		SYSREG_32(0, c12, c12, 7)
+#define ICC_SGI1R_EL1		SYSREG_64(0, c12)
 
 #define ICC_IGRPEN1_EN		0x1
 
@@ -55,3 +56,17 @@ u32 gic_read_ack(void)
 	arm_read_sysreg(ICC_IAR1_EL1, val);
 	return val;
 }
+
+void gic_send_self_sgi(unsigned int sgi)
+{
+	u32 mpidr;
+
+	arm_read_sysreg(MPIDR_EL1, mpidr);
+
+	/* target list bit of Aff0, Aff1 at 16, INTID at 24, Aff2 at 32 */
+	arm_write_sysreg(ICC_SGI1R_EL1,
+			 (u64)((mpidr >> 16) & 0xff) << 32 |
+			 (sgi & 0xf) << 24 |
+			 ((mpidr >> 8) & 0xff) << 16 |
+			 1 << (mpidr & 0xf));
+}
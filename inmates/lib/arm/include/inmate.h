@@ -41,6 +41,7 @@ void __attribute__((interrupt("IRQ"))) __attribute__((used)) vector_irq(void);
 typedef void (*irq_handler_t)(unsigned int);
 void gic_setup(irq_handler_t handler);
 void gic_enable_irq(unsigned int irq);
+void gic_send_self_sgi(unsigned int sgi);
 
 unsigned long timer_get_frequency(void);
 u64 timer_get_ticks(void);
@@ -210,6 +210,9 @@ void delay_us(unsigned long microsecs);
 unsigned long apic_timer_init(unsigned int vector);
 void apic_timer_set(unsigned long timeout_ns);
 
+int tsc_deadline_init(unsigned int vector);
+void tsc_deadline_set(unsigned long timeout_ns);
+
 enum map_type { MAP_CACHED, MAP_UNCACHED };
 
 void *alloc(unsigned long size, unsigned long align);
@@ -231,4 +234,24 @@ void smp_start_cpu(unsigned int cpu_id, void (*entry)(void));
 
 #include "../inmate_common.h"
 
+#ifndef __ASSEMBLY__
+#include <jailhouse/ivshmem-ring.h>
+#include <jailhouse/virtio-ivshmem.h>
+
+struct virtio_ivshmem_dev {
+	u16 bdf;
+	u32 *registers;
+	void *shmem;
+	void *buffers;
+	u32 buffer_size;
+	u64 features;
+	unsigned int num_queues;
+	struct virtio_ivshmem_vq vqs[VIRTIO_IVSHMEM_MAX_QUEUES];
+};
+
+int virtio_ivshmem_init(struct virtio_ivshmem_dev *dev, u32 device_id,
+			u64 features, unsigned int irq_vector);
+void virtio_ivshmem_kick(struct virtio_ivshmem_dev *dev);
+#endif
+
 #endif /* !_JAILHOUSE_INMATE_H */
@@ -20,6 +20,12 @@
 #define X2APIC_TMCCT		0x839
 #define X2APIC_TDCR		0x83e
 
+#define X2APIC_LVTT_TSC_DEADLINE	(2 << 17)
+
+#define MSR_IA32_TSC_DEADLINE	0x6e0
+
+#define X86_FEATURE_TSC_DEADLINE	(1 << 24)
+
 static unsigned long divided_apic_freq;
 static unsigned long pm_timer_last[SMP_MAX_CPUS];
 static unsigned long pm_timer_overflows[SMP_MAX_CPUS];
@@ -142,3 +148,31 @@ void apic_timer_set(unsigned long timeout_ns)
 		(unsigned long long)timeout_ns * divided_apic_freq;
 	write_msr(X2APIC_TMICT, ticks / NS_PER_SEC);
 }
+
+/* requires tsc_init, returns -1 if the CPU lacks the TSC deadline mode */
+int tsc_deadline_init(unsigned int vector)
+{
+	u32 eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	if (!(ecx & X86_FEATURE_TSC_DEADLINE))
+		return -1;
+
+	write_msr(X2APIC_LVTT, vector | X2APIC_LVTT_TSC_DEADLINE);
+	/* SDM 10.5.4.1: order the mode switch before deadline writes */
+	asm volatile("mfence" : : : "memory");
+
+	return 0;
+}
+
+/*
+ * Unlike the initial count register, IA32_TSC_DEADLINE does not need to be
+ * intercepted by the hypervisor, so arming the timer causes no VM exit.
+ */
+void tsc_deadline_set(unsigned long timeout_ns)
+{
+	u64 ticks = (timeout_ns / NS_PER_SEC) * tsc_freq +
+		(timeout_ns % NS_PER_SEC) * tsc_freq / NS_PER_SEC;
+
+	write_msr(MSR_IA32_TSC_DEADLINE, rdtsc() + ticks);
+}
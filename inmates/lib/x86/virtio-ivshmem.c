@@ -0,0 +1,102 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <inmate.h>
+#include <jailhouse/virtio-ivshmem.h>
+
+#define IVSHMEM_VENDOR_ID	0x1af4
+#define IVSHMEM_DEVICE_ID	0x1110
+
+#define IVSHMEM_CFG_SHMEM_PTR	0x40
+#define IVSHMEM_CFG_SHMEM_SZ	0x48
+
+#define IVSHMEM_REG_DBELL	(12 / 4)
+
+static u64 pci_read_config64(u16 bdf, unsigned int addr)
+{
+	return ((u64)pci_read_config(bdf, addr + 4, 4) << 32) |
+		pci_read_config(bdf, addr, 4);
+}
+
+static void pci_write_config64(u16 bdf, unsigned int addr, u64 val)
+{
+	pci_write_config(bdf, addr + 4, (u32)(val >> 32), 4);
+	pci_write_config(bdf, addr, (u32)val, 4);
+}
+
+/*
+ * Waits for the backend to publish the queue layout, then negotiates the
+ * features and initializes all queues. Queue n raises irq_vector + n.
+ */
+int virtio_ivshmem_init(struct virtio_ivshmem_dev *dev, u32 device_id,
+			u64 features, unsigned int irq_vector)
+{
+	volatile struct virtio_ivshmem_header *hdr;
+	unsigned int n;
+	int bdf = 0;
+	u64 shmem_size;
+
+	while (1) {
+		bdf = pci_find_device(IVSHMEM_VENDOR_ID, IVSHMEM_DEVICE_ID,
+				      bdf);
+		if (bdf < 0)
+			return -1;
+
+		dev->bdf = bdf;
+		dev->shmem = (void *)pci_read_config64(bdf,
+						       IVSHMEM_CFG_SHMEM_PTR);
+		shmem_size = pci_read_config64(bdf, IVSHMEM_CFG_SHMEM_SZ);
+		map_range(dev->shmem, shmem_size, MAP_CACHED);
+
+		hdr = dev->shmem;
+		while (hdr->magic != VIRTIO_IVSHMEM_MAGIC)
+			cpu_relax();
+		if (hdr->device_id == device_id)
+			break;
+		bdf++;
+	}
+
+	dev->registers = (u32 *)(((u64)dev->shmem + shmem_size +
+				  PAGE_SIZE - 1) & PAGE_MASK);
+	pci_write_config64(bdf, PCI_CFG_BAR, (u64)dev->registers);
+	pci_write_config64(bdf, PCI_CFG_BAR + 16,
+			   (u64)dev->registers + PAGE_SIZE);
+	pci_write_config(bdf, PCI_CFG_COMMAND, PCI_CMD_MEM | PCI_CMD_MASTER,
+			 2);
+	map_range(dev->registers, 2 * PAGE_SIZE, MAP_UNCACHED);
+
+	hdr->status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+	dev->features = hdr->device_features & features;
+	hdr->driver_features = dev->features;
+	hdr->status |= VIRTIO_STATUS_FEATURES_OK;
+
+	dev->num_queues = hdr->num_queues;
+	if (dev->num_queues > VIRTIO_IVSHMEM_MAX_QUEUES)
+		dev->num_queues = VIRTIO_IVSHMEM_MAX_QUEUES;
+	for (n = 0; n < dev->num_queues; n++) {
+		vring_setup(&dev->vqs[n],
+			    dev->shmem + hdr->queue_offset[n],
+			    hdr->queue_size);
+		memset((void *)dev->vqs[n].desc, 0,
+		       vring_size(hdr->queue_size));
+		pci_msix_set_vector(bdf, irq_vector + n, n);
+	}
+	dev->buffers = dev->shmem + hdr->buffer_offset;
+	dev->buffer_size = hdr->buffer_size;
+
+	virtio_ivshmem_wmb();
+	hdr->status |= VIRTIO_STATUS_DRIVER_OK;
+
+	return 0;
+}
+
+void virtio_ivshmem_kick(struct virtio_ivshmem_dev *dev)
+{
+	mmio_write32(dev->registers + IVSHMEM_REG_DBELL, 0);
+}
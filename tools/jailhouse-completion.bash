@@ -1,7 +1,7 @@
 # bash completion for jailhouse
 #
 # Copyright (c) Benjamin Block, 2014
-# Copyright (c) Siemens AG, 2015
+# Copyright (c) Siemens AG, 2015, 2016
 #
 # Authors:
 #  Benjamin Block <bebl@mageta.org>
@@ -220,6 +220,21 @@ function _jailhouse_cell() {
 		# takes only one argument (id/name)
 		_jailhouse_get_id "${cur}" "${prev}" || return 1
 		;;
+	set-cache)
+		# first the id/name, then start and size that we can't predict
+		_jailhouse_get_id "${cur}" "${prev}" && return 0
+
+		local type_pos=6
+		[ "${COMP_WORDS[3]}" = "--name" ] && type_pos=7
+
+		if [ "${COMP_CWORD}" -eq "${type_pos}" ]; then
+			COMPREPLY=( $( compgen -W "code data rootshared" -- \
+					"${cur}") )
+		elif [[ "${COMP_CWORD}" -eq $((type_pos + 1)) &&
+			( "${prev}" = "code" || "${prev}" = "data" ) ]]; then
+			COMPREPLY=( $( compgen -W "rootshared" -- "${cur}") )
+		fi
+		;;
 	linux)
 		_jailhouse_cell_linux || return 1
 		;;
@@ -293,7 +308,8 @@ function _jailhouse() {
 	command="enable disable cell config hardware --help"
 
 	# second level
-	command_cell="create load start shutdown destroy linux list stats"
+	command_cell="create load start shutdown destroy set-cache linux list \
+		stats"
 	command_config="create collect"
 
 	# ${COMP_WORDS} array containing the words on the current command line
@@ -0,0 +1,315 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2016
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Root cell backend for virtio over ivshmem. It serves a virtio-console
+ * (stdin/stdout) or a virtio-net device (TAP interface) to the peer cell of
+ * an ivshmem device. It uses the /dev/jailhouse-ivshmem<N> device of the
+ * Jailhouse driver for the memory mappings, the interrupt and the doorbell.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <linux/types.h>
+
+#include <jailhouse.h>
+#include <jailhouse/virtio-ivshmem.h>
+
+#define RX_QUEUE		0
+#define TX_QUEUE		1
+#define NUM_QUEUES		2
+#define DEFAULT_QUEUE_SIZE	256
+
+#define PAGE_SIZE		4096UL
+#define PAGE_ALIGN(x)		(((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+struct backend {
+	void *shmem;
+	unsigned long shmem_size;
+	volatile struct virtio_ivshmem_header *hdr;
+	unsigned long queue_offset[NUM_QUEUES];
+	struct virtio_ivshmem_vq vqs[NUM_QUEUES];
+	unsigned int hdr_len;
+	int dev_fd, event_fd, in_fd, out_fd;
+	int rx_head;
+	int rx_blocked;
+};
+
+static void help(const char *prog, int exit_status)
+{
+	printf("Usage: %s IVSHMEM-DEVICE { console | net TAP-NAME } "
+	       "[QUEUE-SIZE]\n", prog);
+	exit(exit_status);
+}
+
+static void open_ivshmem(struct backend *be, const char *dev)
+{
+	struct jailhouse_ivshmem_eventfd params;
+	struct jailhouse_ivshmem_info info;
+
+	be->dev_fd = open(dev, O_RDWR);
+	if (be->dev_fd < 0) {
+		perror(dev);
+		exit(1);
+	}
+	if (ioctl(be->dev_fd, JAILHOUSE_IVSHMEM_GET_INFO, &info) < 0) {
+		perror("JAILHOUSE_IVSHMEM_GET_INFO");
+		exit(1);
+	}
+	if (info.num_vectors == 0) {
+		fprintf(stderr, "%s: no interrupt vector\n", dev);
+		exit(1);
+	}
+
+	be->shmem_size = info.shmem_size;
+	be->shmem = mmap(NULL, be->shmem_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, be->dev_fd, info.shmem_offset);
+	if (be->shmem == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	/* the driver always signals on vector 0, see virtio-ivshmem.h */
+	be->event_fd = eventfd(0, 0);
+	if (be->event_fd < 0) {
+		perror("eventfd");
+		exit(1);
+	}
+	params.vector = 0;
+	params.fd = be->event_fd;
+	if (ioctl(be->dev_fd, JAILHOUSE_IVSHMEM_SET_EVENTFD, &params) < 0) {
+		perror("JAILHOUSE_IVSHMEM_SET_EVENTFD");
+		exit(1);
+	}
+}
+
+static int open_tap(const char *name)
+{
+	struct ifreq ifr;
+	int fd;
+
+	fd = open("/dev/net/tun", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/net/tun");
+		exit(1);
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		perror("TUNSETIFF");
+		exit(1);
+	}
+	return fd;
+}
+
+static void setup_header(struct backend *be, __u32 device_id,
+			 unsigned int queue_size)
+{
+	volatile struct virtio_ivshmem_header *hdr = be->hdr;
+	unsigned long offset = PAGE_ALIGN(sizeof(*hdr));
+	unsigned int n;
+
+	memset(be->shmem, 0, offset);
+
+	hdr->revision = VIRTIO_IVSHMEM_REVISION;
+	hdr->device_id = device_id;
+	hdr->device_features = 1ULL << VIRTIO_RING_F_EVENT_IDX;
+	if (device_id == VIRTIO_ID_NET) {
+		hdr->device_features |= 1ULL << VIRTIO_NET_F_MAC;
+		/* locally administered address */
+		hdr->config[0] = 0x02;
+		hdr->config[5] = 0x01;
+	}
+	hdr->num_queues = NUM_QUEUES;
+	hdr->queue_size = queue_size;
+	for (n = 0; n < NUM_QUEUES; n++) {
+		/* the driver could overwrite the header, keep our own copy */
+		be->queue_offset[n] = offset;
+		hdr->queue_offset[n] = offset;
+		offset += PAGE_ALIGN(vring_size(queue_size));
+	}
+	if (offset >= be->shmem_size) {
+		fprintf(stderr, "shared memory too small\n");
+		exit(1);
+	}
+	hdr->buffer_offset = offset;
+	hdr->buffer_size = be->shmem_size - offset;
+
+	virtio_ivshmem_wmb();
+	hdr->magic = VIRTIO_IVSHMEM_MAGIC;
+}
+
+static void notify(struct backend *be, __u32 queue)
+{
+	if (ioctl(be->dev_fd, JAILHOUSE_IVSHMEM_DOORBELL, &queue) < 0)
+		perror("JAILHOUSE_IVSHMEM_DOORBELL");
+}
+
+/*
+ * The descriptor must be a private copy: the peer can rewrite the ring at any
+ * time, so it must not be read again after validation.
+ */
+static void *buffer(struct backend *be, const struct vring_desc *desc)
+{
+	if (desc->addr >= be->shmem_size ||
+	    desc->len > be->shmem_size - desc->addr) {
+		fprintf(stderr, "invalid buffer %llx/%x\n",
+			(unsigned long long)desc->addr, desc->len);
+		exit(1);
+	}
+	return be->shmem + desc->addr;
+}
+
+static void process_tx(struct backend *be)
+{
+	struct virtio_ivshmem_vq *vq = &be->vqs[TX_QUEUE];
+	struct vring_desc desc;
+	unsigned int count = 0;
+	__u16 head;
+
+	while (vring_device_get_avail(vq, &head)) {
+		desc = vq->desc[head % vq->num];
+		if (desc.len > be->hdr_len &&
+		    write(be->out_fd, buffer(be, &desc) + be->hdr_len,
+			  desc.len - be->hdr_len) < 0)
+			perror("write");
+		vring_device_add_used(vq, head, 0);
+		count++;
+	}
+	/* one index update and at most one doorbell per batch */
+	if (count > 0 && vring_device_publish(vq))
+		notify(be, TX_QUEUE);
+}
+
+/* Returns 1 if more input may be pending, 0 otherwise. */
+static int process_rx(struct backend *be)
+{
+	struct virtio_ivshmem_vq *vq = &be->vqs[RX_QUEUE];
+	struct vring_desc desc;
+	void *data;
+	__u16 head;
+	ssize_t len;
+
+	if (be->rx_head < 0) {
+		if (!vring_device_get_avail(vq, &head)) {
+			/* wait for the driver to add receive buffers */
+			be->rx_blocked = 1;
+			return 0;
+		}
+		be->rx_head = head;
+	}
+
+	desc = vq->desc[be->rx_head % vq->num];
+	if (desc.len <= be->hdr_len) {
+		fprintf(stderr, "receive buffer too small\n");
+		exit(1);
+	}
+	data = buffer(be, &desc);
+
+	len = read(be->in_fd, data + be->hdr_len, desc.len - be->hdr_len);
+	if (len == 0) {
+		fprintf(stderr, "end of input\n");
+		exit(0);
+	}
+	if (len < 0) {
+		if (errno != EAGAIN)
+			perror("read");
+		return 0;
+	}
+
+	memset(data, 0, be->hdr_len);
+	vring_device_add_used(vq, be->rx_head, len + be->hdr_len);
+	be->rx_head = -1;
+	if (vring_device_publish(vq))
+		notify(be, RX_QUEUE);
+
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int queue_size = DEFAULT_QUEUE_SIZE;
+	struct backend be = { .rx_head = -1 };
+	struct pollfd fds[2];
+	__u32 device_id;
+	__u64 events;
+	int arg = 2;
+	unsigned int n;
+
+	if (argc < 3)
+		help(argv[0], 1);
+
+	if (strcmp(argv[2], "console") == 0) {
+		device_id = VIRTIO_ID_CONSOLE;
+		be.in_fd = STDIN_FILENO;
+		be.out_fd = STDOUT_FILENO;
+		arg = 3;
+	} else if (strcmp(argv[2], "net") == 0 && argc >= 4) {
+		device_id = VIRTIO_ID_NET;
+		be.in_fd = be.out_fd = open_tap(argv[3]);
+		be.hdr_len = sizeof(struct virtio_net_hdr);
+		arg = 4;
+	} else {
+		help(argv[0], 1);
+	}
+	if (argc > arg)
+		queue_size = strtoul(argv[arg], NULL, 0);
+	if (queue_size == 0 || queue_size & (queue_size - 1) ||
+	    queue_size > 32768)
+		help(argv[0], 1);
+
+	open_ivshmem(&be, argv[1]);
+	be.hdr = be.shmem;
+
+	setup_header(&be, device_id, queue_size);
+
+	fprintf(stderr, "Waiting for driver...\n");
+	while (!(be.hdr->status & VIRTIO_STATUS_DRIVER_OK))
+		usleep(10000);
+	for (n = 0; n < NUM_QUEUES; n++)
+		vring_setup(&be.vqs[n], be.shmem + be.queue_offset[n],
+			    queue_size);
+	fprintf(stderr, "Driver ready, features %llx\n",
+		(unsigned long long)be.hdr->driver_features);
+
+	fcntl(be.in_fd, F_SETFL, fcntl(be.in_fd, F_GETFL) | O_NONBLOCK);
+
+	fds[0].fd = be.event_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = be.in_fd;
+
+	while (1) {
+		/* without receive buffers, wait for the driver to add some */
+		fds[1].events = be.rx_blocked ? 0 : POLLIN;
+		if (poll(fds, 2, -1) < 0) {
+			perror("poll");
+			return 1;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (read(be.event_fd, &events, sizeof(events)) < 0)
+				perror("read");
+			process_tx(&be);
+			be.rx_blocked = 0;
+		}
+		if (fds[1].revents & POLLIN)
+			while (process_rx(&be))
+				; /* empty loop */
+	}
+}
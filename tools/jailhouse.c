@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 
 #include <jailhouse.h>
+#include <jailhouse/cell-config.h>
 
 #define JAILHOUSE_EXEC_DIR	LIBEXECDIR "/jailhouse"
 #define JAILHOUSE_DEVICE	"/dev/jailhouse"
@@ -62,7 +63,9 @@ static void __attribute__((noreturn)) help(char *prog, int exit_status)
 	       "             [-a | --address ADDRESS] ...\n"
 	       "   cell start { ID | [--name] NAME }\n"
 	       "   cell shutdown { ID | [--name] NAME }\n"
-	       "   cell destroy { ID | [--name] NAME }\n",
+	       "   cell destroy { ID | [--name] NAME }\n"
+	       "   cell set-cache { ID | [--name] NAME } START SIZE "
+				"[code | data] [rootshared]\n",
 	       basename(prog));
 	for (ext = extensions; ext->cmd; ext++)
 		printf("   %s %s %s\n", ext->cmd, ext->subcmd, ext->help);
@@ -358,6 +361,53 @@ static int cell_simple_cmd(int argc, char *argv[], unsigned int command)
 	return err;
 }
 
+static int cell_set_cache(int argc, char *argv[])
+{
+	struct jailhouse_cell_cache cell_cache;
+	int id_args, arg_num, err, fd;
+	char *endp;
+
+	id_args = parse_cell_id(&cell_cache.cell_id, argc - 3, &argv[3]);
+	arg_num = 3 + id_args;
+	if (id_args == 0 || arg_num + 2 > argc)
+		help(argv[0], 1);
+
+	errno = 0;
+	cell_cache.start = strtoul(argv[arg_num++], &endp, 0);
+	if (errno != 0 || *endp != 0)
+		help(argv[0], 1);
+	cell_cache.size = strtoul(argv[arg_num++], &endp, 0);
+	if (errno != 0 || *endp != 0)
+		help(argv[0], 1);
+
+	cell_cache.type = JAILHOUSE_CACHE_L3;
+	cell_cache.flags = 0;
+
+	if (arg_num < argc && strcmp(argv[arg_num], "code") == 0) {
+		cell_cache.type = JAILHOUSE_CACHE_L3_CODE;
+		arg_num++;
+	} else if (arg_num < argc && strcmp(argv[arg_num], "data") == 0) {
+		cell_cache.type = JAILHOUSE_CACHE_L3_DATA;
+		arg_num++;
+	}
+	if (arg_num < argc && strcmp(argv[arg_num], "rootshared") == 0) {
+		cell_cache.flags = JAILHOUSE_CACHE_ROOTSHARED;
+		arg_num++;
+	}
+	if (arg_num != argc)
+		help(argv[0], 1);
+
+	fd = open_dev();
+
+	err = ioctl(fd, JAILHOUSE_CELL_SET_CACHE, &cell_cache);
+	if (err)
+		perror("JAILHOUSE_CELL_SET_CACHE");
+
+	close(fd);
+
+	return err;
+}
+
 static int cell_management(int argc, char *argv[])
 {
 	int err;
@@ -375,6 +425,8 @@ static int cell_management(int argc, char *argv[])
 		err = cell_shutdown_load(argc, argv, SHUTDOWN);
 	} else if (strcmp(argv[2], "destroy") == 0) {
 		err = cell_simple_cmd(argc, argv, JAILHOUSE_CELL_DESTROY);
+	} else if (strcmp(argv[2], "set-cache") == 0) {
+		err = cell_set_cache(argc, argv);
 	} else {
 		call_extension_script("cell", argc, argv);
 		help(argv[0], 1);